@@ -0,0 +1,185 @@
+#include <Arduino.h>
+#include <math.h>
+#include "fastmath.h"
+#include "pid.h"
+#include "GyverPID.h"
+
+// On-device kernel benchmarks, built instead of the flight firmware by the
+// esp32doit-devkit-v1-bench env. Results go to the serial monitor once at
+// boot: CPU cycles per call (including the indirect call every row pays)
+// and the largest error against double libm over the same input sweep, then
+// cycles per three-axis PID update.
+
+namespace Bench
+{
+    const int SAMPLES = 4096;
+
+    typedef float (*KernelType)(float, float);
+
+    typedef struct
+    {
+        const char *name;
+        KernelType kernel;
+        KernelType reference;
+        bool relative;
+        const float *a, *b;
+    } CaseType;
+
+    float signedInputs[SAMPLES], otherInputs[SAMPLES], positiveInputs[SAMPLES];
+    volatile float sink;
+
+    float fastInvSqrt(float x, float) { return FastMath::invSqrt(x); }
+    float libmfInvSqrt(float x, float) { return 1.0f / sqrtf(x); }
+    float libmInvSqrt(float x, float) { return (float)(1.0 / sqrt((double)x)); }
+
+    float fastSqrt(float x, float) { return FastMath::sqrt(x); }
+    float libmfSqrt(float x, float) { return sqrtf(x); }
+    float libmSqrt(float x, float) { return (float)sqrt((double)x); }
+
+    float fastAtan2(float y, float x) { return FastMath::atan2(y, x); }
+    float libmfAtan2(float y, float x) { return atan2f(y, x); }
+    float libmAtan2(float y, float x) { return (float)atan2((double)y, (double)x); }
+
+    float fastAsin(float x, float) { return FastMath::asin(x); }
+    float libmfAsin(float x, float) { return asinf(x); }
+    float libmAsin(float x, float) { return (float)asin((double)x); }
+
+    void fillInputs()
+    {
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            float t = (float)i / (SAMPLES - 1);
+            signedInputs[i] = 2.0f * t - 1.0f;
+            otherInputs[i] = cosf(t * 40.0f);
+            positiveInputs[i] = 0.01f + 4.0f * t;
+        }
+    }
+
+    float cyclesPerCall(const CaseType &test, KernelType kernel)
+    {
+        uint32_t start = ESP.getCycleCount();
+
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            sink = kernel(test.a[i], test.b[i]);
+        }
+
+        return (float)(ESP.getCycleCount() - start) / SAMPLES;
+    }
+
+    float maxError(const CaseType &test)
+    {
+        float worst = 0.0f;
+
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            float expected = test.reference(test.a[i], test.b[i]);
+            float error = fabsf(test.kernel(test.a[i], test.b[i]) - expected);
+
+            if (test.relative)
+            {
+                error /= fabsf(expected);
+            }
+
+            worst = max(worst, error);
+        }
+
+        return worst;
+    }
+
+    // All three axes per call: PidBank against the three GyverPID objects the
+    // rate loops used before, fed the same inputs and dt.
+    void runPid(const char *name, float jitter)
+    {
+        PidBankType bank;
+        GyverPID regulators[PID_AXES];
+
+        Pid::init(bank, 80.0f);
+
+        for (int axis = 0; axis < PID_AXES; axis++)
+        {
+            Pid::setGains(bank, axis, 0.5f, 0.2f, 0.01f);
+            Pid::setLimits(bank, axis, -150.0f, 150.0f);
+            regulators[axis] = GyverPID(0.5f, 0.2f, 0.01f);
+            regulators[axis].setLimits(-150, 150);
+        }
+
+        uint32_t start = ESP.getCycleCount();
+
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            Pid::setDt(bank, 0.001f + jitter * otherInputs[i]);
+
+            for (int axis = 0; axis < PID_AXES; axis++)
+            {
+                bank.setpoint[axis] = signedInputs[i];
+                bank.input[axis] = otherInputs[i];
+            }
+
+            Pid::update(bank);
+            sink = bank.output[PID_ROLL];
+        }
+
+        float bankCycles = (float)(ESP.getCycleCount() - start) / SAMPLES;
+        start = ESP.getCycleCount();
+
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            for (int axis = 0; axis < PID_AXES; axis++)
+            {
+                regulators[axis].setpoint = signedInputs[i];
+                regulators[axis].input = otherInputs[i];
+                regulators[axis].setDtS(0.001f + jitter * otherInputs[i]);
+                sink = regulators[axis].getResult();
+            }
+        }
+
+        float gyverCycles = (float)(ESP.getCycleCount() - start) / SAMPLES;
+
+        Serial.printf("%-12s %9.1f %9.1f\n", name, bankCycles, gyverCycles);
+    }
+
+    void run()
+    {
+        fillInputs();
+
+        const CaseType cases[] = {
+            {"invSqrt", fastInvSqrt, libmInvSqrt, true, positiveInputs, otherInputs},
+            {"sqrt", fastSqrt, libmSqrt, true, positiveInputs, otherInputs},
+            {"atan2", fastAtan2, libmAtan2, false, signedInputs, otherInputs},
+            {"asin", fastAsin, libmAsin, false, signedInputs, otherInputs}};
+        const KernelType libmf[] = {libmfInvSqrt, libmfSqrt, libmfAtan2, libmfAsin};
+
+        Serial.println("kernel      fast  libm float  libm double  max error (double libm)");
+
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        {
+            const CaseType &test = cases[i];
+
+            Serial.printf("%-8s %7.1f %11.1f %12.1f  %.2e%s\n", test.name,
+                          cyclesPerCall(test, test.kernel),
+                          cyclesPerCall(test, libmf[i]),
+                          cyclesPerCall(test, test.reference),
+                          maxError(test), test.relative ? " rel" : " abs");
+        }
+
+        Serial.println("pid, 3 axes   PidBank  GyverPID");
+        runPid("steady dt", 0.0f);
+        runPid("jittered dt", 20e-6f);
+    }
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    while (!Serial)
+    {
+    }
+
+    Bench::run();
+}
+
+void loop()
+{
+    delay(1000);
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include "fastmath.h"
+
+// Host build of the FastMath rows of bench.cpp, run with
+// `pio run -e native-bench -t exec`. Nanoseconds per call on the build
+// machine. x86 has single instruction sqrt and divide where the ESP32 FPU
+// iterates, so only the atan2 and asin ratios carry over to the device.
+// The error bounds are asserted in test/test_fastmath.
+
+namespace Bench
+{
+    const int SAMPLES = 4096;
+    const int ROUNDS = 2000;
+
+    typedef float (*KernelType)(float, float);
+
+    typedef struct
+    {
+        const char *name;
+        KernelType kernel;
+        KernelType libmf;
+        KernelType libm;
+        const float *a, *b;
+    } CaseType;
+
+    float signedInputs[SAMPLES], otherInputs[SAMPLES], positiveInputs[SAMPLES];
+    volatile float sink;
+
+    float fastInvSqrt(float x, float) { return FastMath::invSqrt(x); }
+    float libmfInvSqrt(float x, float) { return 1.0f / sqrtf(x); }
+    float libmInvSqrt(float x, float) { return (float)(1.0 / sqrt((double)x)); }
+
+    float fastSqrt(float x, float) { return FastMath::sqrt(x); }
+    float libmfSqrt(float x, float) { return sqrtf(x); }
+    float libmSqrt(float x, float) { return (float)sqrt((double)x); }
+
+    float fastAtan2(float y, float x) { return FastMath::atan2(y, x); }
+    float libmfAtan2(float y, float x) { return atan2f(y, x); }
+    float libmAtan2(float y, float x) { return (float)atan2((double)y, (double)x); }
+
+    float fastAsin(float x, float) { return FastMath::asin(x); }
+    float libmfAsin(float x, float) { return asinf(x); }
+    float libmAsin(float x, float) { return (float)asin((double)x); }
+
+    void fillInputs()
+    {
+        for (int i = 0; i < SAMPLES; i++)
+        {
+            float t = (float)i / (SAMPLES - 1);
+            signedInputs[i] = 2.0f * t - 1.0f;
+            otherInputs[i] = cosf(t * 40.0f);
+            positiveInputs[i] = 0.01f + 4.0f * t;
+        }
+    }
+
+    // Called through a pointer like on the device, so every row pays the
+    // same call overhead
+    double nanosecondsPerCall(const CaseType &test, KernelType kernel)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int round = 0; round < ROUNDS; round++)
+        {
+            for (int i = 0; i < SAMPLES; i++)
+            {
+                sink = kernel(test.a[i], test.b[i]);
+            }
+        }
+
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / ((double)ROUNDS * SAMPLES);
+    }
+
+    void run()
+    {
+        fillInputs();
+
+        const CaseType cases[] = {
+            {"invSqrt", fastInvSqrt, libmfInvSqrt, libmInvSqrt, positiveInputs, otherInputs},
+            {"sqrt", fastSqrt, libmfSqrt, libmSqrt, positiveInputs, otherInputs},
+            {"atan2", fastAtan2, libmfAtan2, libmAtan2, signedInputs, otherInputs},
+            {"asin", fastAsin, libmfAsin, libmAsin, signedInputs, otherInputs}};
+
+        printf("kernel, ns   fast  libm float  libm double\n");
+
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        {
+            const CaseType &test = cases[i];
+
+            printf("%-8s %7.2f %11.2f %12.2f\n", test.name,
+                   nanosecondsPerCall(test, test.kernel),
+                   nanosecondsPerCall(test, test.libmf),
+                   nanosecondsPerCall(test, test.libm));
+        }
+    }
+}
+
+int main()
+{
+    Bench::run();
+    return 0;
+}
@@ -87,6 +87,13 @@ public:
         _dt = new_dt;
     }
 
+    // установка времени дискретизации в секундах (без округления до мс)
+    void setDtS(float new_dt_s)
+    {
+        _dt_s = new_dt_s;
+        _dt = new_dt_s * 1000.0f;
+    }
+
     datatype setpoint = 0; // заданная величина, которую должен поддерживать регулятор
     datatype input = 0;    // сигнал с датчика (например температура, которую мы регулируем)
     datatype output = 0;   // выход с регулятора на управляющее устройство (например величина ШИМ или угол поворота серво)
@@ -0,0 +1,45 @@
+#include <stdint.h>
+
+#ifndef SRC_AUTOTUNE_H_
+#define SRC_AUTOTUNE_H_
+
+typedef enum
+{
+    AUTOTUNE_IDLE,
+    AUTOTUNE_RUNNING,
+    AUTOTUNE_DONE,
+    AUTOTUNE_FAILED
+} AutotuneStateType;
+
+// Relay feedback (Astrom-Hagglund) experiment on one axis. The relay output
+// replaces the regulator output until the loop settles into a limit cycle,
+// whose period and fundamental give the ultimate period and gain.
+typedef struct
+{
+    AutotuneStateType state;
+    float setpoint;
+    float relayAmplitude; // output units, +/- around 0
+    float hysteresis;     // input units
+    float timeout;        // s
+    uint8_t cyclesRequired;
+
+    bool relayHigh;
+    float time;
+    float lastRiseTime;
+    uint8_t cycles;
+    float periodSum;
+    float correlationSum; // integral of (input - setpoint) * output over the measured cycles
+
+    float ultimateGain, ultimatePeriod;
+    float kp, ki, kd;
+    float output;
+} AutotuneType;
+
+namespace Autotune
+{
+    void start(AutotuneType &tuner, float setpoint, float relayAmplitude, float hysteresis, uint8_t cycles, float timeout);
+    float update(AutotuneType &tuner, float input, float dt);
+    void cancel(AutotuneType &tuner);
+}
+
+#endif
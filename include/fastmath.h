@@ -0,0 +1,84 @@
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SRC_FASTMATH_H_
+#define SRC_FASTMATH_H_
+
+// Single precision helpers for the estimator / mixer hot path. The ESP32 FPU
+// has no double support, so anything in here must stay in float. The
+// float-check env makes any implicit float -> double promotion in src/ a
+// build error. Error bounds are checked by test/test_fastmath.
+
+namespace FastMath
+{
+    constexpr float PI_F = 3.14159265f;
+    constexpr float HALF_PI_F = 1.57079633f;
+    constexpr float RAD_TO_DEG_F = 57.2957795f;
+    constexpr float DEG_TO_RAD_F = 0.0174532925f;
+
+    // 1 / sqrt(x), x > 0. Two Newton steps, relative error < 5e-6.
+    inline float invSqrt(float x)
+    {
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        bits = 0x5f375a86 - (bits >> 1);
+
+        float y;
+        memcpy(&y, &bits, sizeof(y));
+
+        float halfX = 0.5f * x;
+        y = y * (1.5f - halfX * y * y);
+        y = y * (1.5f - halfX * y * y);
+        return y;
+    }
+
+    // sqrt(x), x >= 0. Relative error < 5e-6.
+    inline float sqrt(float x)
+    {
+        return x > 0.0f ? x * invSqrt(x) : 0.0f;
+    }
+
+    // Full quadrant atan2. Absolute error < 2e-6 rad, atan2(0, 0) = 0.
+    inline float atan2(float y, float x)
+    {
+        float absX = x < 0.0f ? -x : x;
+        float absY = y < 0.0f ? -y : y;
+
+        if (absX == 0.0f && absY == 0.0f)
+        {
+            return 0.0f;
+        }
+
+        bool swapped = absY > absX;
+        float z = swapped ? absX / absY : absY / absX;
+        float z2 = z * z;
+
+        float angle = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f + z2 * (0.05265332f + z2 * -0.01172120f)))));
+
+        if (swapped)
+        {
+            angle = HALF_PI_F - angle;
+        }
+        if (x < 0.0f)
+        {
+            angle = PI_F - angle;
+        }
+        return y < 0.0f ? -angle : angle;
+    }
+
+    // asin(x), clamped to [-1, 1]. Absolute error < 7.5e-5 rad.
+    inline float asin(float x)
+    {
+        bool negative = x < 0.0f;
+        float a = negative ? -x : x;
+        if (a > 1.0f)
+        {
+            a = 1.0f;
+        }
+
+        float angle = HALF_PI_F - sqrt(1.0f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f + a * -0.0187293f)));
+        return negative ? -angle : angle;
+    }
+}
+
+#endif
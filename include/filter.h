@@ -0,0 +1,20 @@
+#ifndef SRC_FILTER_H_
+#define SRC_FILTER_H_
+
+// Second order IIR section, transposed direct form II.
+typedef struct
+{
+    float b0, b1, b2, a1, a2;
+    float s1, s2;
+} BiquadType;
+
+namespace Filter
+{
+    void initLowPass(BiquadType &filter, float sampleRate, float cutoff);
+    void initNotch(BiquadType &filter, float sampleRate, float centre, float q);
+    void setNotch(BiquadType &filter, float sampleRate, float centre, float q);
+    void reset(BiquadType &filter, float value);
+    float apply(BiquadType &filter, float input);
+}
+
+#endif
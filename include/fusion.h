@@ -0,0 +1,41 @@
+#ifndef SRC_FUSION_H_
+#define SRC_FUSION_H_
+
+typedef struct
+{
+    float x, y, z;
+} AxisType;
+
+typedef enum
+{
+    FUSION_FIXED,   // constant accel weight
+    FUSION_ADAPTIVE // accel weight scaled by how much the accel looks like pure gravity
+} FusionModeType;
+
+typedef struct
+{
+    float normMean;     // g, exponential moving average of |accel|
+    float normVariance; // g^2, exponential moving variance of |accel|
+    float trust;        // 0..1, last computed weight applied to accPart
+} AccelTrustType;
+
+// Complementary filter for roll (x) and pitch (y): the integrated gyro is
+// pulled towards the gravity direction the accel reports by accPart per
+// sample. No sensor or Arduino dependency, so the host tests run it as is.
+typedef struct
+{
+    FusionModeType mode;
+    float accPart;
+    AccelTrustType trust;
+    AxisType angles; // rad, z unused
+} FusionType;
+
+namespace Fusion
+{
+    void init(FusionType &fusion, FusionModeType mode, float accPart);
+    void setMode(FusionType &fusion, FusionModeType mode);
+    float updateAccelTrust(AccelTrustType &state, float accelNorm);
+    void update(FusionType &fusion, const AxisType &accel, const AxisType &gyro, float dt);
+}
+
+#endif
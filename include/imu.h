@@ -1,9 +1,15 @@
 #include "mpu9250.h"
 #include <MedianFilter.h>
+#include "timing.h"
+#include "filter.h"
+#include "fusion.h"
 
 #ifndef SRC_IMU_H_
 #define SRC_IMU_H_
 
+#define RPM_FILTER_MOTORS 4
+#define RPM_FILTER_HARMONICS 3
+
 typedef struct
 {
     median_filter_t x, y, z;
@@ -11,14 +17,31 @@ typedef struct
 
 typedef struct
 {
-    float x, y, z;
-} AxisType;
+    BiquadType x, y, z;
+} AxisFilterType;
 
 typedef struct
 {
     AxisType accel, gyro;
+    TimestampType timestamp; // when the sensor took the sample, from its FIFO frame clock
 } ImuType;
 
+typedef struct
+{
+    uint32_t clipCount;       // samples at the ends of the accel range, current window
+    float mean;               // g, slow moving average (gravity + bias)
+    float meanSquare;         // g^2, moving average of (sample - mean)^2
+    float rms;                // g, sqrt(meanSquare), filled in by getVibration()
+    float peak;               // g, largest |sample - mean| in the current window
+    uint32_t windowClipCount; // clipCount of the last complete window
+    float windowPeak;         // g, peak of the last complete window
+} VibrationAxisType;
+
+typedef struct
+{
+    VibrationAxisType x, y, z;
+} VibrationType;
+
 namespace Imu
 {
     void init();
@@ -29,6 +52,14 @@ namespace Imu
     void serialPrintlnf(const char *format, ...);
     void printAxis(AxisType axis);
     AxisType getDegAngles();
+    AxisType getDegRates();
+    TimestampType getTimestamp();
+    void setFusionMode(FusionModeType mode);
+    AccelTrustType getAccelTrust();
+    uint32_t getFifoOverflows();
+    VibrationType getVibration();
+    void resetVibration();
+    void setMotorFrequencies(const float *frequencies, uint8_t count);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include <stdint.h>
+
+#include "protocol.h"
+
+#ifndef SRC_LINKFILTER_H_
+#define SRC_LINKFILTER_H_
+
+typedef struct
+{
+    uint32_t received;   // frames applied
+    uint32_t lost;       // sequence numbers never seen
+    uint32_t outOfOrder; // arrived after a newer frame, dropped
+    uint32_t stale;      // older than the age limit, dropped
+    uint32_t invalid;    // wrong size, version or CRC
+    float quality;       // 0..1, moving share of frames that arrived in time
+} LinkStatsType;
+
+// Latest-wins acceptance of control frames that may arrive late, twice or out
+// of order. No I/O or clock of its own, the caller passes its millisecond time.
+typedef struct
+{
+    LinkStatsType stats;
+    uint32_t lastSequence;
+    uint32_t lastClientTimestamp; // ms, client clock
+    int32_t minDelay;             // ms, baseline (local - client) clock difference
+    int32_t windowMinDelay;       // ms, smallest difference in the current window
+    int32_t lastWindowMinDelay;
+    uint32_t windowStart; // ms, local clock
+} LinkFilterType;
+
+namespace LinkFilter
+{
+    void start(LinkFilterType &filter, const ControlFrameType &frame, uint32_t now);
+    bool accept(LinkFilterType &filter, const ControlFrameType &frame, uint32_t now);
+}
+
+#endif
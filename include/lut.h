@@ -0,0 +1,38 @@
+#ifndef SRC_LUT_H_
+#define SRC_LUT_H_
+
+#define LUT_MAX_POINTS 17
+
+// Evenly spaced breakpoints with linear interpolation, clamped at both ends.
+typedef struct
+{
+    float inputMin, inputMax;
+    float invStep; // points per input unit, so lookup needs no division
+    int count;
+    float values[LUT_MAX_POINTS];
+} LutType;
+
+// Two tables so one task can rebuild a table while others keep reading it:
+// the writer fills the spare copy and then flips `active` in one store.
+// Readers hold a table between acquire() and release(); spare() returns NULL
+// while somebody still holds the table it would hand out, so back-to-back
+// publishes can't rewrite a table that is still being read.
+typedef struct
+{
+    LutType tables[2];
+    volatile int active;
+    volatile int readers[2];
+} LutBufferType;
+
+namespace Lut
+{
+    void init(LutType &lut, float inputMin, float inputMax, const float *values, int count);
+    float lookup(const LutType &lut, float input);
+    LutType *spare(LutBufferType &buffer);
+    void publish(LutBufferType &buffer);
+    const LutType &acquire(LutBufferType &buffer);
+    void release(LutBufferType &buffer, const LutType &lut);
+    float lookup(LutBufferType &buffer, float input);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "eigen.h" // NOLINT
+#include "Eigen/Dense"
+
+#ifndef SRC_MIXER_H_
+#define SRC_MIXER_H_
+
+#define MIXER_MAX_MOTORS 8
+
+// Rows are motors, columns are roll, pitch, yaw contributions.
+typedef Eigen::Matrix<float, MIXER_MAX_MOTORS, 3> MixerMatrixType;
+typedef Eigen::Matrix<float, MIXER_MAX_MOTORS, 1> MotorVectorType;
+
+typedef enum
+{
+    FRAME_QUAD_X,
+    FRAME_QUAD_PLUS,
+    FRAME_HEXA_X,
+    FRAME_HEXA_PLUS,
+    FRAME_OCTO_X,
+    FRAME_OCTO_PLUS
+} FrameType;
+
+typedef struct
+{
+    MixerMatrixType matrix;
+    uint8_t motorCount;
+    float outputMin, outputMax;
+    bool airmode; // raise throttle at the bottom instead of losing authority
+} MixerType;
+
+namespace Mixer
+{
+    void init(MixerType &mixer, FrameType frame, float outputMin, float outputMax);
+    void initGeometry(MixerType &mixer, uint8_t motorCount, const float *angles, const float *spins, float outputMin, float outputMax);
+    void setAirmode(MixerType &mixer, bool enabled);
+    void mix(const MixerType &mixer, float throttle, float roll, float pitch, float yaw, float *motors);
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SRC_MOTORS_H_
+#define SRC_MOTORS_H_
+
+#include <Arduino.h>
+
+#define MOTORS_COUNT 4
+
+// ESC output. Build with -DMOTOR_DSHOT=150/300/600 for DShot on the RMT, or
+// -DMOTOR_PROTOCOL=ONESHOT125/ONESHOT42/MULTISHOT for the short analog pulses
+// refreshed at the loop rate; otherwise the ESCs get 50 Hz 1000..2000 us PWM.
+// Adding -DMOTOR_DSHOT_BIDIR to DShot reads the motor RPM back from the ESCs.
+namespace Motors
+{
+    void init();
+    void write(const float *values, uint8_t count); // 0..180 per motor, same scale as Servo::write
+    bool readFrequencies(float *frequencies, uint8_t count); // Hz per motor, false without RPM telemetry
+    void stop();
+}
+
+#endif
@@ -0,0 +1,18 @@
+#include <Arduino.h>
+
+#ifndef SRC_PARAMS_H_
+#define SRC_PARAMS_H_
+
+// Float parameters persisted in NVS. set() only touches RAM; flash writes
+// stall both cores, so they happen in commit(), called while disarmed and
+// from a task other than the control loop.
+namespace Params
+{
+    void init();
+    float get(const char *key, float fallback);
+    void set(const char *key, float value);
+    bool dirty();
+    void commit();
+}
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef SRC_PID_H_
+#define SRC_PID_H_
+
+#define PID_AXES 3
+
+typedef enum
+{
+    PID_ROLL = 0,
+    PID_PITCH = 1,
+    PID_YAW = 2
+} PidAxisType;
+
+// Roll, pitch and yaw regulators processed together, one array per field.
+// Error-based P and I, D on measurement through a first order low-pass,
+// integrator clamped so it never winds up past the output limits.
+typedef struct
+{
+    float kp[PID_AXES], ki[PID_AXES], kd[PID_AXES];
+    float outputMin[PID_AXES], outputMax[PID_AXES];
+    float dRc; // s, time constant of the D low-pass
+    float gainScale[PID_AXES]; // gain schedule multiplier on P and D, 1 by default
+
+    // Derived from the gains for the current dt by setDt()
+    float dt;
+    float kiDt[PID_AXES], kdInvDt[PID_AXES];
+    float dAlpha;
+
+    float setpoint[PID_AXES], input[PID_AXES], output[PID_AXES];
+    float integral[PID_AXES], prevInput[PID_AXES], dTerm[PID_AXES];
+    bool primed[PID_AXES]; // prevInput holds a real measurement, false after init() and reset()
+} PidBankType;
+
+namespace Pid
+{
+    void init(PidBankType &bank, float dCutoff);
+    void setGains(PidBankType &bank, int axis, float kp, float ki, float kd);
+    void setLimits(PidBankType &bank, int axis, float min, float max);
+    void setDt(PidBankType &bank, float dt);
+    void update(PidBankType &bank);
+    void reset(PidBankType &bank);
+    void resetAxis(PidBankType &bank, int axis);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SRC_PROTOCOL_H_
+#define SRC_PROTOCOL_H_
+
+#define PROTOCOL_VERSION 2
+
+// Binary control frame, little-endian, no padding:
+//   0  uint8   version (PROTOCOL_VERSION)
+//   1  uint8   flags (PROTOCOL_FLAG_*)
+//   2  uint32  sequence, +1 per frame sent
+//   6  uint32  client timestamp, ms on the client's own clock
+//  10  int16   throttle stick, 0..180 in 1/100
+//  12  int16   pitch, deg in 1/100
+//  14  int16   roll, deg in 1/100
+//  16  int16   yaw, deg/s in 1/100
+//  18  uint16  CRC-16/CCITT-FALSE of bytes 0..17
+#define PROTOCOL_CONTROL_SIZE 20
+#define PROTOCOL_CHANNEL_SCALE 100
+
+#define PROTOCOL_FLAG_STOP 0x01 // emergency stop, sticks are ignored
+
+// Binary telemetry frame, flight controller -> client, same conventions:
+//   0  uint8   version (PROTOCOL_VERSION)
+//   1  uint8   flags (PROTOCOL_TELEMETRY_*)
+//   2  uint32  sequence
+//   6  uint32  flight controller time, ms
+//  10  uint32  client timestamp of the last control frame applied, for round trip time
+//  14  int16   roll, pitch, yaw angle, deg in 1/100
+//  20  int16   roll, pitch, yaw rate, deg/s in 1/10
+//  26  uint16  4 motor outputs, 0..150 (Rc MAX_MOTOR_VALUE) in 1/100
+//  34  uint16  throttle after the throttle curve, 0..150 in 1/100
+//  36  uint8   accel trust, 0..255
+//  37  uint8   UDP link quality, 0..255
+//  38  uint16  x, y, z vibration RMS, g in 1/1000
+//  44  uint16  x, y, z vibration peak over the last complete 1 s window, g in 1/1000
+//  50  uint16  accel samples clipped in that window, all axes, saturates
+//  52  uint16  battery cell voltage, mV
+//  54  uint16  CRC-16/CCITT-FALSE of bytes 0..53
+#define PROTOCOL_TELEMETRY_SIZE 56
+#define PROTOCOL_TELEMETRY_MOTORS 4
+
+#define PROTOCOL_TELEMETRY_ARMED 0x01    // throttle above zero
+#define PROTOCOL_TELEMETRY_AUTOTUNE 0x02 // autotune experiment running
+#define PROTOCOL_TELEMETRY_UDP 0x04      // control is coming over UDP
+
+typedef struct
+{
+    uint8_t flags;
+    uint32_t sequence;
+    uint32_t clientTimestamp;
+    float throttle, pitch, roll, yaw;
+} ControlFrameType;
+
+typedef struct
+{
+    uint8_t flags;
+    uint32_t sequence;
+    uint32_t timestamp;
+    uint32_t clientTimestamp;
+    float angles[3], rates[3];
+    float motors[PROTOCOL_TELEMETRY_MOTORS];
+    float throttle;
+    float accelTrust, linkQuality;
+    float vibration[3], vibrationPeak[3];
+    uint32_t clipCount;
+    float cellVoltage;
+} TelemetryFrameType;
+
+namespace Protocol
+{
+    uint16_t crc16(const uint8_t *data, size_t len);
+    bool decodeControl(const uint8_t *data, size_t len, ControlFrameType &frame);
+    size_t encodeControl(const ControlFrameType &frame, uint8_t *data);
+    size_t encodeTelemetry(const TelemetryFrameType &frame, uint8_t *data);
+    bool isNewer(uint32_t sequence, uint32_t last);
+
+    uint16_t readU16(const uint8_t *data);
+    uint32_t readU32(const uint8_t *data);
+    void writeU16(uint8_t *data, uint16_t value);
+    void writeU32(uint8_t *data, uint32_t value);
+}
+
+#endif
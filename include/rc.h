@@ -4,14 +4,17 @@
 #include <WiFiAP.h>
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
-#include <ESP32Servo.h>
 #include <ArduinoJson.h>
 
+#include "protocol.h"
+
 namespace Rc
 {
     void init();
     void process();
-    void handleWebSocketMessage(void *arg, uint8_t *data, size_t len);
+    void handleWebSocketMessage(AsyncWebSocket *server, AsyncWebSocketClient *client, uint8_t opcode, const uint8_t *data, size_t len);
+    int stateChannel(const AwsFrameInfo &info);
+    void applyControl(const ControlFrameType &frame);
     void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
     void emergencyStop();
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#define TELEMETRY_MAX_CLIENTS 8
+#define TELEMETRY_MAX_FRAME 64 // bytes, largest encoded frame send() accepts
+
+typedef struct
+{
+    uint32_t id;       // AsyncWebSocketClient id, 0 for a free slot
+    uint32_t period;   // ms between frames, 0 = off
+    uint32_t lastSent; // millis()
+    uint32_t sent;
+    uint32_t dropped;  // frames skipped because the previous one was still queued
+} TelemetryClientType;
+
+// Schedules telemetry frames per WebSocket client and for the UDP peer. The
+// caller encodes a frame once when due() says so. send() only publishes it;
+// the WebSocket clients get it from the async_tcp task, which owns them.
+namespace Telemetry
+{
+    void addClient(uint32_t id);
+    void removeClient(uint32_t id);
+    void setRate(uint32_t id, float hz);
+    bool due();
+    void send(AsyncWebSocket &ws, const uint8_t *data, size_t len);
+}
+
+#endif
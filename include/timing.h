@@ -0,0 +1,15 @@
+#include <Arduino.h>
+
+#ifndef SRC_TIMING_H_
+#define SRC_TIMING_H_
+
+// Monotonic microseconds since boot. 64 bit, so it never wraps in practice.
+typedef int64_t TimestampType;
+
+namespace Timing
+{
+    TimestampType now();
+    float toSeconds(TimestampType duration);
+}
+
+#endif
@@ -0,0 +1,24 @@
+#include <Arduino.h>
+
+#include "protocol.h"
+#include "linkfilter.h"
+
+#ifndef SRC_UDPLINK_H_
+#define SRC_UDPLINK_H_
+
+typedef void (*ControlHandlerType)(const ControlFrameType &frame);
+
+// Control frames (protocol.h) as UDP datagrams, screened by LinkFilter. Nothing
+// is retransmitted and only the newest frame counts, so a lost packet costs
+// one update instead of stalling the stream the way TCP does. Whoever sent the
+// last valid frame is the peer that send() replies to.
+namespace UdpLink
+{
+    void init(uint16_t port, ControlHandlerType handler);
+    bool active();
+    bool lost();
+    bool send(const uint8_t *data, size_t len);
+    LinkStatsType getStats();
+}
+
+#endif
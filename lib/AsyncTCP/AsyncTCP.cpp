@@ -36,12 +36,14 @@ extern "C"{
  * */
 
 typedef enum {
-    LWIP_TCP_SENT, LWIP_TCP_RECV, LWIP_TCP_FIN, LWIP_TCP_ERROR, LWIP_TCP_POLL, LWIP_TCP_CLEAR, LWIP_TCP_ACCEPT, LWIP_TCP_CONNECTED, LWIP_TCP_DNS
+    LWIP_TCP_SENT, LWIP_TCP_RECV, LWIP_TCP_FIN, LWIP_TCP_ERROR, LWIP_TCP_POLL, LWIP_TCP_CLEAR, LWIP_TCP_ACCEPT, LWIP_TCP_CONNECTED, LWIP_TCP_DNS, LWIP_TCP_CALL
 } lwip_event_t;
 
-typedef struct {
+typedef struct lwip_event_packet_t {
         lwip_event_t event;
         void *arg;
+        uint32_t generation; //ring order stamp, 0 once cancelled
+        struct lwip_event_packet_t * next; //overflow list link
         union {
                 struct {
                         void * pcb;
@@ -51,8 +53,7 @@ typedef struct {
                         int8_t err;
                 } error;
                 struct {
-                        tcp_pcb * pcb;
-                        uint16_t len;
+                        tcp_pcb * pcb; //byte count is kept by the client, see _s_lwip_sent
                 } sent;
                 struct {
                         tcp_pcb * pcb;
@@ -73,11 +74,75 @@ typedef struct {
                         const char * name;
                         ip_addr_t addr;
                 } dns;
+                struct {
+                        void (*fn)(void *);
+                } call;
         };
 } lwip_event_packet_t;
 
-static xQueueHandle _async_queue;
-static TaskHandle_t _async_service_task_handle = NULL;
+/*
+ * Event packet pool
+ * Lock-free free list over a static array: the head holds the first free
+ * index in the low 16 bits and a tag in the high 16 bits, bumped on every
+ * change so a stale compare-and-swap can never succeed (ABA).
+ * */
+
+#define EVENT_POOL_EMPTY 0xFFFF
+
+static lwip_event_packet_t _event_pool[CONFIG_ASYNC_TCP_EVENT_POOL_SIZE];
+static uint16_t _event_pool_next[CONFIG_ASYNC_TCP_EVENT_POOL_SIZE];
+static uint32_t _event_pool_in_use = 0;
+static uint32_t _event_pool_high_water = 0;
+static uint32_t _event_pool_exhausted = 0;
+static uint32_t _event_pool_head = []() {
+    for (int i = 0; i < CONFIG_ASYNC_TCP_EVENT_POOL_SIZE; ++ i) {
+        _event_pool_next[i] = (i + 1 < CONFIG_ASYNC_TCP_EVENT_POOL_SIZE) ? i + 1 : EVENT_POOL_EMPTY;
+    }
+    return (uint32_t)0;
+}();
+
+static lwip_event_packet_t * _alloc_event(){
+    uint32_t head = __atomic_load_n(&_event_pool_head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint16_t index = head & 0xFFFF;
+        if(index == EVENT_POOL_EMPTY){
+            __atomic_add_fetch(&_event_pool_exhausted, 1, __ATOMIC_RELAXED);
+            return (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+        }
+        uint32_t next = ((head + 0x10000) & 0xFFFF0000) | _event_pool_next[index];
+        if(__atomic_compare_exchange_n(&_event_pool_head, &head, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            uint32_t in_use = __atomic_add_fetch(&_event_pool_in_use, 1, __ATOMIC_RELAXED);
+            if(in_use > _event_pool_high_water){
+                _event_pool_high_water = in_use;
+            }
+            return &_event_pool[index];
+        }
+    }
+}
+
+static void _free_event(lwip_event_packet_t * e){
+    if(e < _event_pool || e >= _event_pool + CONFIG_ASYNC_TCP_EVENT_POOL_SIZE){
+        free((void*)(e));
+        return;
+    }
+    uint16_t index = e - _event_pool;
+    __atomic_sub_fetch(&_event_pool_in_use, 1, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&_event_pool_head, __ATOMIC_ACQUIRE);
+    uint32_t next;
+    do {
+        _event_pool_next[index] = head & 0xFFFF;
+        next = ((head + 0x10000) & 0xFFFF0000) | index;
+    } while(!__atomic_compare_exchange_n(&_event_pool_head, &head, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+async_event_pool_stats_t async_event_pool_stats(){
+    async_event_pool_stats_t stats;
+    stats.size = CONFIG_ASYNC_TCP_EVENT_POOL_SIZE;
+    stats.in_use = _event_pool_in_use;
+    stats.high_water = _event_pool_high_water;
+    stats.exhausted = _event_pool_exhausted;
+    return stats;
+}
 
 
 SemaphoreHandle_t _slots_lock;
@@ -93,70 +158,241 @@ static uint32_t _closed_index = []() {
 }();
 
 
-static inline bool _init_async_event_queue(){
-    if(!_async_queue){
-        _async_queue = xQueueCreate(32, sizeof(lwip_event_packet_t *));
-        if(!_async_queue){
-            return false;
-        }
-    }
-    return true;
-}
+/*
+ * Event ring
+ * Bounded FIFO of event packets shared by the lwIP thread (producer) and the
+ * async task (consumer). Producers never block: each event type has a policy
+ * that decides what happens when the ring is busy or full, and the consumer
+ * sleeps on a task notification instead of a queue. Events that must not be
+ * lost go to an unbounded overflow list once the ring is full; while that list
+ * is in use nothing else enters the ring, so order is kept.
+ * */
 
-static inline bool _send_async_event(lwip_event_packet_t ** e){
-    return _async_queue && xQueueSend(_async_queue, e, portMAX_DELAY) == pdPASS;
-}
+#define EVENT_POLICY_COALESCE  0 //merge into a pending POLL of the same connection, drop above the soft limit
+#define EVENT_POLICY_DEFER     1 //refuse above the soft limit so lwIP keeps and retries the data
+#define EVENT_POLICY_QUEUE     2 //append, may use the reserved slots, then the overflow list
+#define EVENT_POLICY_FRONT     3 //as QUEUE, but goes to the front
+
+//Indexed by lwip_event_t. SENT is never merged or dropped here: at most one
+//is queued per connection and it drains the client's pending byte count.
+static const uint8_t _event_policy[] = {
+    EVENT_POLICY_QUEUE,    //LWIP_TCP_SENT
+    EVENT_POLICY_DEFER,    //LWIP_TCP_RECV
+    EVENT_POLICY_QUEUE,    //LWIP_TCP_FIN
+    EVENT_POLICY_QUEUE,    //LWIP_TCP_ERROR
+    EVENT_POLICY_COALESCE, //LWIP_TCP_POLL
+    EVENT_POLICY_FRONT,    //LWIP_TCP_CLEAR (unused, clears are done by generation)
+    EVENT_POLICY_FRONT,    //LWIP_TCP_ACCEPT
+    EVENT_POLICY_FRONT,    //LWIP_TCP_CONNECTED
+    EVENT_POLICY_QUEUE,    //LWIP_TCP_DNS
+    EVENT_POLICY_QUEUE     //LWIP_TCP_CALL
+};
+
+//Slots kept free for QUEUE/FRONT events (FIN, ERROR, ACCEPT, ...)
+#define EVENT_RING_RESERVED    (CONFIG_ASYNC_TCP_QUEUE_SIZE / 8)
+#define EVENT_RING_SOFT_LIMIT  (CONFIG_ASYNC_TCP_QUEUE_SIZE - EVENT_RING_RESERVED)
+
+//Connections cleared while they still had events in the ring
+#define EVENT_CANCEL_SLOTS 8
 
-static inline bool _prepend_async_event(lwip_event_packet_t ** e){
-    return _async_queue && xQueueSendToFront(_async_queue, e, portMAX_DELAY) == pdPASS;
-}
+typedef struct {
+    void * arg;
+    uint32_t before; //events of arg with a generation below this are stale
+} event_cancel_t;
+
+static lwip_event_packet_t * _event_ring[CONFIG_ASYNC_TCP_QUEUE_SIZE];
+static uint32_t _event_ring_head = 0;
+static uint32_t _event_ring_count = 0;
+static lwip_event_packet_t * _event_overflow_head = NULL;
+static lwip_event_packet_t * _event_overflow_tail = NULL;
+static uint32_t _event_overflow_count = 0;
+static uint32_t _event_generation = 1;
+static event_cancel_t _event_cancel[EVENT_CANCEL_SLOTS];
+static portMUX_TYPE _event_ring_mux = portMUX_INITIALIZER_UNLOCKED;
+static async_event_queue_stats_t _event_ring_stats = { CONFIG_ASYNC_TCP_QUEUE_SIZE, 0, 0, 0, 0, 0, 0, 0 };
+
+static TaskHandle_t _async_service_task_handle = NULL;
 
-static inline bool _get_async_event(lwip_event_packet_t ** e){
-    return _async_queue && xQueueReceive(_async_queue, e, portMAX_DELAY) == pdPASS;
+static inline lwip_event_packet_t * _ring_at(uint32_t i){
+    return _event_ring[(_event_ring_head + i) % CONFIG_ASYNC_TCP_QUEUE_SIZE];
 }
 
-static bool _remove_events_with_arg(void * arg){
-    lwip_event_packet_t * first_packet = NULL;
-    lwip_event_packet_t * packet = NULL;
+static bool _coalesce_event(lwip_event_packet_t * e, bool full){
+    //only the newest entry is a merge candidate unless the ring is full,
+    //then any pending POLL of the same connection will do
+    uint32_t first = full ? 0 : _event_ring_count - 1;
+    for (uint32_t i = _event_ring_count; i-- > first; ) {
+        lwip_event_packet_t * p = _ring_at(i);
+        if(p->event == e->event && p->arg == e->arg){
+            return true;
+        }
+    }
+    return false;
+}
 
-    if(!_async_queue){
+static void _overflow_event(lwip_event_packet_t * e, bool front){
+    e->next = NULL;
+    if(!_event_overflow_head){
+        _event_overflow_head = _event_overflow_tail = e;
+    } else if(front){
+        e->next = _event_overflow_head;
+        _event_overflow_head = e;
+    } else {
+        _event_overflow_tail->next = e;
+        _event_overflow_tail = e;
+    }
+    _event_overflow_count++;
+    _event_ring_stats.overflowed++;
+}
+
+//Returns false only when a DEFER event was refused; any other event is
+//consumed (queued, merged or dropped) and must not be touched afterwards
+static bool _send_async_event(lwip_event_packet_t * e){
+    uint8_t policy = _event_policy[e->event];
+    bool queued = false;
+    bool merged = false;
+
+    portENTER_CRITICAL(&_event_ring_mux);
+    e->generation = _event_generation;
+    if(++_event_generation == 0){
+        _event_generation = 1;
+    }
+    bool busy = _event_ring_count >= EVENT_RING_SOFT_LIMIT || _event_overflow_head;
+    if(policy == EVENT_POLICY_COALESCE && _event_ring_count){
+        merged = _coalesce_event(e, busy);
+    }
+    if(merged){
+        _event_ring_stats.coalesced++;
+    } else if(policy == EVENT_POLICY_DEFER && busy){
+        _event_ring_stats.deferred++;
+        portEXIT_CRITICAL(&_event_ring_mux);
         return false;
+    } else if(policy == EVENT_POLICY_COALESCE && busy){
+        //only POLL, the next one comes half a second later
+        _event_ring_stats.dropped++;
+    } else if(_event_ring_count >= CONFIG_ASYNC_TCP_QUEUE_SIZE || _event_overflow_head){
+        _overflow_event(e, policy == EVENT_POLICY_FRONT);
+        queued = true;
+    } else {
+        if(policy == EVENT_POLICY_FRONT){
+            _event_ring_head = (_event_ring_head + CONFIG_ASYNC_TCP_QUEUE_SIZE - 1) % CONFIG_ASYNC_TCP_QUEUE_SIZE;
+            _event_ring[_event_ring_head] = e;
+        } else {
+            _event_ring[(_event_ring_head + _event_ring_count) % CONFIG_ASYNC_TCP_QUEUE_SIZE] = e;
+        }
+        _event_ring_count++;
+        if(_event_ring_count > _event_ring_stats.high_water){
+            _event_ring_stats.high_water = _event_ring_count;
+        }
+        queued = true;
     }
-    //figure out which is the first packet so we can keep the order
-    while(!first_packet){
-        if(xQueueReceive(_async_queue, &first_packet, 0) != pdPASS){
-            return false;
+    portEXIT_CRITICAL(&_event_ring_mux);
+
+    if(queued){
+        if(_async_service_task_handle){
+            xTaskNotifyGive(_async_service_task_handle);
         }
-        //discard packet if matching
-        if((int)first_packet->arg == (int)arg){
-            free(first_packet);
-            first_packet = NULL;
-        //return first packet to the back of the queue
-        } else if(xQueueSend(_async_queue, &first_packet, portMAX_DELAY) != pdPASS){
-            return false;
+    } else {
+        _free_event(e);
+    }
+    return true;
+}
+
+static bool _event_is_stale(lwip_event_packet_t * e){
+    for (int i = 0; i < EVENT_CANCEL_SLOTS; ++ i) {
+        if(_event_cancel[i].arg == e->arg && (int32_t)(e->generation - _event_cancel[i].before) < 0){
+            return true;
         }
     }
+    return e->generation == 0;
+}
 
-    while(xQueuePeek(_async_queue, &packet, 0) == pdPASS && packet != first_packet){
-        if(xQueueReceive(_async_queue, &packet, 0) != pdPASS){
-            return false;
+static void _get_async_event(lwip_event_packet_t ** e){
+    for (;;) {
+        portENTER_CRITICAL(&_event_ring_mux);
+        while(_event_ring_count || _event_overflow_head){
+            lwip_event_packet_t * p;
+            if(_event_ring_count){
+                p = _event_ring[_event_ring_head];
+                _event_ring_head = (_event_ring_head + 1) % CONFIG_ASYNC_TCP_QUEUE_SIZE;
+                _event_ring_count--;
+            } else {
+                p = _event_overflow_head;
+                _event_overflow_head = p->next;
+                if(!_event_overflow_head){
+                    _event_overflow_tail = NULL;
+                }
+                _event_overflow_count--;
+            }
+            bool stale = _event_is_stale(p);
+            if(!_event_ring_count && !_event_overflow_head){
+                //nothing older than the current generation is left
+                memset(_event_cancel, 0, sizeof(_event_cancel));
+            }
+            if(!stale){
+                portEXIT_CRITICAL(&_event_ring_mux);
+                *e = p;
+                return;
+            }
+            _event_ring_stats.cancelled++;
+            portEXIT_CRITICAL(&_event_ring_mux);
+            if(p->event == LWIP_TCP_RECV){
+                pbuf_free(p->recv.pb);
+            }
+            _free_event(p);
+            portENTER_CRITICAL(&_event_ring_mux);
         }
-        if((int)packet->arg == (int)arg){
-            free(packet);
-            packet = NULL;
-        } else if(xQueueSend(_async_queue, &packet, portMAX_DELAY) != pdPASS){
-            return false;
+        portEXIT_CRITICAL(&_event_ring_mux);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+//Invalidates every pending event of arg in O(1) by recording the current
+//generation; the consumer drops them as they come out of the ring
+static void _remove_events_with_arg(void * arg){
+    portENTER_CRITICAL(&_event_ring_mux);
+    if(_event_ring_count || _event_overflow_head){
+        int slot = -1;
+        for (int i = 0; i < EVENT_CANCEL_SLOTS; ++ i) {
+            if(_event_cancel[i].arg == arg || (slot < 0 && _event_cancel[i].arg == NULL)){
+                slot = i;
+            }
+        }
+        if(slot >= 0){
+            _event_cancel[slot].arg = arg;
+            _event_cancel[slot].before = _event_generation;
+        } else {
+            //every cancel slot is taken, mark the packets themselves
+            for (uint32_t i = 0; i < _event_ring_count; ++ i) {
+                lwip_event_packet_t * p = _ring_at(i);
+                if(p->arg == arg){
+                    p->generation = 0;
+                }
+            }
+            for (lwip_event_packet_t * p = _event_overflow_head; p; p = p->next) {
+                if(p->arg == arg){
+                    p->generation = 0;
+                }
+            }
         }
     }
-    return true;
+    portEXIT_CRITICAL(&_event_ring_mux);
+}
+
+async_event_queue_stats_t async_event_queue_stats(){
+    portENTER_CRITICAL(&_event_ring_mux);
+    async_event_queue_stats_t stats = _event_ring_stats;
+    stats.depth = _event_ring_count + _event_overflow_count;
+    portEXIT_CRITICAL(&_event_ring_mux);
+    return stats;
 }
 
 static void _handle_async_event(lwip_event_packet_t * e){
-    if(e->arg == NULL){
+    if(e->event == LWIP_TCP_CALL){
+        e->call.fn(e->arg);
+    } else if(e->arg == NULL){
         // do nothing when arg is NULL
         //ets_printf("event arg == NULL: 0x%08x\n", e->recv.pcb);
-    } else if(e->event == LWIP_TCP_CLEAR){
-        _remove_events_with_arg(e->arg);
     } else if(e->event == LWIP_TCP_RECV){
         //ets_printf("-R: 0x%08x\n", e->recv.pcb);
         AsyncClient::_s_recv(e->arg, e->recv.pcb, e->recv.pb, e->recv.err);
@@ -165,7 +401,7 @@ static void _handle_async_event(lwip_event_packet_t * e){
         AsyncClient::_s_fin(e->arg, e->fin.pcb, e->fin.err);
     } else if(e->event == LWIP_TCP_SENT){
         //ets_printf("-S: 0x%08x\n", e->sent.pcb);
-        AsyncClient::_s_sent(e->arg, e->sent.pcb, e->sent.len);
+        AsyncClient::_s_sent(e->arg, e->sent.pcb);
     } else if(e->event == LWIP_TCP_POLL){
         //ets_printf("-P: 0x%08x\n", e->poll.pcb);
         AsyncClient::_s_poll(e->arg, e->poll.pcb);
@@ -182,25 +418,24 @@ static void _handle_async_event(lwip_event_packet_t * e){
         //ets_printf("D: 0x%08x %s = %s\n", e->arg, e->dns.name, ipaddr_ntoa(&e->dns.addr));
         AsyncClient::_s_dns_found(e->dns.name, &e->dns.addr, e->arg);
     }
-    free((void*)(e));
+    _free_event(e);
 }
 
 static void _async_service_task(void *pvParameters){
     lwip_event_packet_t * packet = NULL;
     for (;;) {
-        if(_get_async_event(&packet)){
+        _get_async_event(&packet);
 #if CONFIG_ASYNC_TCP_USE_WDT
-            if(esp_task_wdt_add(NULL) != ESP_OK){
-                log_e("Failed to add async task to WDT");
-            }
+        if(esp_task_wdt_add(NULL) != ESP_OK){
+            log_e("Failed to add async task to WDT");
+        }
 #endif
-            _handle_async_event(packet);
+        _handle_async_event(packet);
 #if CONFIG_ASYNC_TCP_USE_WDT
-            if(esp_task_wdt_delete(NULL) != ESP_OK){
-                log_e("Failed to remove loop task from WDT");
-            }
-#endif
+        if(esp_task_wdt_delete(NULL) != ESP_OK){
+            log_e("Failed to remove loop task from WDT");
         }
+#endif
     }
     vTaskDelete(NULL);
     _async_service_task_handle = NULL;
@@ -214,9 +449,6 @@ static void _stop_async_task(){
 }
 */
 static bool _start_async_task(){
-    if(!_init_async_event_queue()){
-        return false;
-    }
     if(!_async_service_task_handle){
         xTaskCreateUniversal(_async_service_task, "async_tcp", 8192 * 2, NULL, 3, &_async_service_task_handle, CONFIG_ASYNC_TCP_RUNNING_CORE);
         if(!_async_service_task_handle){
@@ -226,47 +458,53 @@ static bool _start_async_task(){
     return true;
 }
 
+bool async_tcp_call(void (*fn)(void *), void * arg){
+    if(!_async_service_task_handle){
+        return false;
+    }
+    lwip_event_packet_t * e = _alloc_event();
+    if(!e){
+        return false;
+    }
+    e->event = LWIP_TCP_CALL;
+    e->arg = arg;
+    e->call.fn = fn;
+    _send_async_event(e);
+    return true;
+}
+
 /*
  * LwIP Callbacks
  * */
 
 static int8_t _tcp_clear_events(void * arg) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
-    e->event = LWIP_TCP_CLEAR;
-    e->arg = arg;
-    if (!_prepend_async_event(&e)) {
-        free((void*)(e));
-    }
+    _remove_events_with_arg(arg);
     return ERR_OK;
 }
 
 static int8_t _tcp_connected(void * arg, tcp_pcb * pcb, int8_t err) {
     //ets_printf("+C: 0x%08x\n", pcb);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
     e->event = LWIP_TCP_CONNECTED;
     e->arg = arg;
     e->connected.pcb = pcb;
     e->connected.err = err;
-    if (!_prepend_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
     return ERR_OK;
 }
 
 static int8_t _tcp_poll(void * arg, struct tcp_pcb * pcb) {
     //ets_printf("+P: 0x%08x\n", pcb);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
     e->event = LWIP_TCP_POLL;
     e->arg = arg;
     e->poll.pcb = pcb;
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
     return ERR_OK;
 }
 
 static int8_t _tcp_recv(void * arg, struct tcp_pcb * pcb, struct pbuf *pb, int8_t err) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
     e->arg = arg;
     if(pb){
         //ets_printf("+R: 0x%08x\n", pcb);
@@ -274,6 +512,12 @@ static int8_t _tcp_recv(void * arg, struct tcp_pcb * pcb, struct pbuf *pb, int8_
         e->recv.pcb = pcb;
         e->recv.pb = pb;
         e->recv.err = err;
+        if(!_send_async_event(e)){
+            //ring is backed up, lwIP keeps the pbuf and offers it again later
+            _free_event(e);
+            return ERR_MEM;
+        }
+        return ERR_OK;
     } else {
         //ets_printf("+F: 0x%08x\n", pcb);
         e->event = LWIP_TCP_FIN;
@@ -282,38 +526,41 @@ static int8_t _tcp_recv(void * arg, struct tcp_pcb * pcb, struct pbuf *pb, int8_
         //close the PCB in LwIP thread
         AsyncClient::_s_lwip_fin(e->arg, e->fin.pcb, e->fin.err);
     }
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
     return ERR_OK;
 }
 
 static int8_t _tcp_sent(void * arg, struct tcp_pcb * pcb, uint16_t len) {
     //ets_printf("+S: 0x%08x\n", pcb);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    if(arg == NULL){
+        return ERR_OK;
+    }
+    if(!AsyncClient::_s_lwip_sent(arg, len)){
+        //a SENT of this connection is already queued and will pick up len
+        portENTER_CRITICAL(&_event_ring_mux);
+        _event_ring_stats.coalesced++;
+        portEXIT_CRITICAL(&_event_ring_mux);
+        return ERR_OK;
+    }
+    lwip_event_packet_t * e = _alloc_event();
     e->event = LWIP_TCP_SENT;
     e->arg = arg;
     e->sent.pcb = pcb;
-    e->sent.len = len;
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
     return ERR_OK;
 }
 
 static void _tcp_error(void * arg, int8_t err) {
     //ets_printf("+E: 0x%08x\n", arg);
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
     e->event = LWIP_TCP_ERROR;
     e->arg = arg;
     e->error.err = err;
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
 }
 
 static void _tcp_dns_found(const char * name, struct ip_addr * ipaddr, void * arg) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
     //ets_printf("+DNS: name=%s ipaddr=0x%08x arg=%x\n", name, ipaddr, arg);
     e->event = LWIP_TCP_DNS;
     e->arg = arg;
@@ -323,20 +570,16 @@ static void _tcp_dns_found(const char * name, struct ip_addr * ipaddr, void * ar
     } else {
         memset(&e->dns.addr, 0, sizeof(e->dns.addr));
     }
-    if (!_send_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
 }
 
 //Used to switch out from LwIP thread
 static int8_t _tcp_accept(void * arg, AsyncClient * client) {
-    lwip_event_packet_t * e = (lwip_event_packet_t *)malloc(sizeof(lwip_event_packet_t));
+    lwip_event_packet_t * e = _alloc_event();
     e->event = LWIP_TCP_ACCEPT;
     e->arg = arg;
     e->accept.client = client;
-    if (!_prepend_async_event(&e)) {
-        free((void*)(e));
-    }
+    _send_async_event(e);
     return ERR_OK;
 }
 
@@ -557,6 +800,8 @@ AsyncClient::AsyncClient(tcp_pcb* pcb)
 , _timeout_cb_arg(0)
 , _pcb_busy(false)
 , _pcb_sent_at(0)
+, _sent_pending(0)
+, _sent_queued(false)
 , _ack_pcb(true)
 , _rx_last_packet(0)
 , _rx_since_timeout(0)
@@ -694,6 +939,8 @@ bool AsyncClient::connect(IPAddress ip, uint16_t port){
         return false;
     }
 
+    _sent_pending = 0;
+    _sent_queued = false;
     tcp_arg(pcb, this);
     tcp_err(pcb, &_tcp_error);
     tcp_recv(pcb, &_tcp_recv);
@@ -909,7 +1156,7 @@ int8_t AsyncClient::_fin(tcp_pcb* pcb, int8_t err) {
     return ERR_OK;
 }
 
-int8_t AsyncClient::_sent(tcp_pcb* pcb, uint16_t len) {
+int8_t AsyncClient::_sent(tcp_pcb* pcb, size_t len) {
     _rx_last_packet = millis();
     //log_i("%u", len);
     _pcb_busy = false;
@@ -1218,8 +1465,23 @@ int8_t AsyncClient::_s_lwip_fin(void * arg, struct tcp_pcb * pcb, int8_t err) {
     return reinterpret_cast<AsyncClient*>(arg)->_lwip_fin(pcb, err);
 }
 
-int8_t AsyncClient::_s_sent(void * arg, struct tcp_pcb * pcb, uint16_t len) {
-    return reinterpret_cast<AsyncClient*>(arg)->_sent(pcb, len);
+//In LwIP Thread: adds len to the bytes waiting to be reported,
+//returns true when a SENT event has to be queued to report them
+bool AsyncClient::_s_lwip_sent(void * arg, uint16_t len) {
+    AsyncClient * c = reinterpret_cast<AsyncClient*>(arg);
+    __atomic_add_fetch(&c->_sent_pending, len, __ATOMIC_RELEASE);
+    return !__atomic_exchange_n(&c->_sent_queued, true, __ATOMIC_ACQ_REL);
+}
+
+//In Async Thread: reports everything acked since the SENT was queued
+int8_t AsyncClient::_s_sent(void * arg, struct tcp_pcb * pcb) {
+    AsyncClient * c = reinterpret_cast<AsyncClient*>(arg);
+    __atomic_store_n(&c->_sent_queued, false, __ATOMIC_RELEASE);
+    uint32_t len = __atomic_exchange_n(&c->_sent_pending, 0, __ATOMIC_ACQ_REL);
+    if(!len){
+        return ERR_OK;
+    }
+    return c->_sent(pcb, len);
 }
 
 void AsyncClient::_s_error(void * arg, int8_t err) {
@@ -36,8 +36,44 @@ extern "C" {
 #define CONFIG_ASYNC_TCP_USE_WDT 1 //if enabled, adds between 33us and 200us per event
 #endif
 
+//Preallocated lwIP event packets; when they run out the heap is used instead
+#ifndef CONFIG_ASYNC_TCP_EVENT_POOL_SIZE
+#define CONFIG_ASYNC_TCP_EVENT_POOL_SIZE 64
+#endif
+
+//Depth of the lwIP -> async task event ring; producers never wait on it
+#ifndef CONFIG_ASYNC_TCP_QUEUE_SIZE
+#define CONFIG_ASYNC_TCP_QUEUE_SIZE 64
+#endif
+
 class AsyncClient;
 
+typedef struct {
+    uint32_t size;       //packets in the pool
+    uint32_t in_use;     //pool packets currently queued or being handled
+    uint32_t high_water; //most pool packets in use at once
+    uint32_t exhausted;  //allocations that found the pool empty and fell back to malloc
+} async_event_pool_stats_t;
+
+async_event_pool_stats_t async_event_pool_stats();
+
+typedef struct {
+    uint32_t size;       //ring capacity
+    uint32_t depth;      //events waiting for the async task
+    uint32_t high_water; //deepest the ring has been
+    uint32_t coalesced;  //POLL/SENT events folded into one already queued
+    uint32_t dropped;    //POLL events discarded above the soft limit
+    uint32_t overflowed; //events parked on the overflow list because the ring was full
+    uint32_t deferred;   //RECV refused with ERR_MEM, lwIP delivers them again
+    uint32_t cancelled;  //events of cleared connections discarded by the async task
+} async_event_queue_stats_t;
+
+async_event_queue_stats_t async_event_queue_stats();
+
+//Runs fn(arg) on the async_tcp task, in order with the connection events, so
+//other tasks can touch clients and servers without racing their callbacks
+bool async_tcp_call(void (*fn)(void *), void * arg);
+
 #define ASYNC_MAX_ACK_TIME 5000
 #define ASYNC_WRITE_FLAG_COPY 0x01 //will allocate new buffer to hold the data while sending (else will hold reference to the data given)
 #define ASYNC_WRITE_FLAG_MORE 0x02 //will not send PSH flag, meaning that there should be more data to be sent before the application should react.
@@ -132,7 +168,8 @@ class AsyncClient {
     static int8_t _s_fin(void *arg, struct tcp_pcb *tpcb, int8_t err);
     static int8_t _s_lwip_fin(void *arg, struct tcp_pcb *tpcb, int8_t err);
     static void _s_error(void *arg, int8_t err);
-    static int8_t _s_sent(void *arg, struct tcp_pcb *tpcb, uint16_t len);
+    static bool _s_lwip_sent(void *arg, uint16_t len);
+    static int8_t _s_sent(void *arg, struct tcp_pcb *tpcb);
     static int8_t _s_connected(void* arg, void* tpcb, int8_t err);
     static void _s_dns_found(const char *name, struct ip_addr *ipaddr, void *arg);
 
@@ -162,6 +199,8 @@ class AsyncClient {
 
     bool _pcb_busy;
     uint32_t _pcb_sent_at;
+    uint32_t _sent_pending; //acked bytes not yet reported, added in the lwIP thread
+    bool _sent_queued;      //a SENT event is on its way to drain _sent_pending
     bool _ack_pcb;
     uint32_t _rx_ack_len;
     uint32_t _rx_last_packet;
@@ -175,7 +214,7 @@ class AsyncClient {
     int8_t _connected(void* pcb, int8_t err);
     void _error(int8_t err);
     int8_t _poll(tcp_pcb* pcb);
-    int8_t _sent(tcp_pcb* pcb, uint16_t len);
+    int8_t _sent(tcp_pcb* pcb, size_t len);
     int8_t _fin(tcp_pcb* pcb, int8_t err);
     int8_t _lwip_fin(tcp_pcb* pcb, int8_t err);
     void _dns_found(struct ip_addr *ipaddr);
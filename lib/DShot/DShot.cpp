@@ -0,0 +1,407 @@
+/*
+ * DShot.cpp
+ */
+
+#include "DShot.h"
+#include "driver/gpio.h"
+
+// 80 MHz APB clock, one tick = 12.5 ns
+#define DSHOT_RMT_CLOCK_DIVIDER 1
+#define DSHOT_RMT_TICKS_PER_SECOND 80000000
+
+#define DSHOT_RX_BUFFER_SIZE 512    // bytes of received items per channel
+#define DSHOT_RX_FILTER_TICKS 10    // glitches shorter than 125 ns are ignored
+#define DSHOT_TELEMETRY_TASK_STACK 2048
+#define DSHOT_TELEMETRY_TASK_CORE 0 // the Arduino loop runs on core 1
+
+DShot *DShot::channels[DSHOT_MAX_CHANNELS] = {NULL};
+bool DShot::receivers[DSHOT_MAX_CHANNELS] = {false};
+TaskHandle_t DShot::telemetryTaskHandle = NULL;
+
+// 5 bit GCR symbol -> nibble, 0xFF for codes that never appear
+static const uint8_t GCR_TO_NIBBLE[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0x0F,
+    0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x05, 0x06, 0x07,
+    0xFF, 0x00, 0x08, 0x01, 0xFF, 0x04, 0x0C, 0xFF};
+
+DShot::DShot(DShotMode mode, bool bidirectional) : mode(mode), bidirectional(bidirectional)
+{
+    memset(items, 0, sizeof(items));
+}
+
+DShot::~DShot()
+{
+    detach();
+}
+
+int DShot::attach(int pin)
+{
+    if (attached())
+    {
+        return 1;
+    }
+
+    // A bidirectional channel n listens on channel n + DSHOT_MAX_CHANNELS / 2
+    int last = bidirectional ? DSHOT_MAX_CHANNELS / 2 : DSHOT_MAX_CHANNELS;
+    int index = 0;
+    while (index < last && (channels[index] != NULL || receivers[index] ||
+                            (bidirectional && (channels[index + last] != NULL || receivers[index + last]))))
+    {
+        index++;
+    }
+
+    if (index >= last)
+    {
+        Serial.println("ERROR no free RMT channel for DShot on pin " + String(pin));
+        return 0;
+    }
+
+    channel = (rmt_channel_t)index;
+
+    rmt_config_t config = {};
+    config.rmt_mode = RMT_MODE_TX;
+    config.channel = channel;
+    config.gpio_num = (gpio_num_t)pin;
+    config.mem_block_num = 1;
+    config.clk_div = DSHOT_RMT_CLOCK_DIVIDER;
+    config.tx_config.loop_en = false;
+    config.tx_config.carrier_en = false;
+    config.tx_config.idle_output_en = true;
+    config.tx_config.idle_level = bidirectional ? RMT_IDLE_LEVEL_HIGH : RMT_IDLE_LEVEL_LOW;
+
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(channel, 0, 0) != ESP_OK)
+    {
+        Serial.println("ERROR configuring RMT for DShot on pin " + String(pin));
+        return 0;
+    }
+
+    // Bit period with a 3/4 active "1" and a 3/8 active "0"; bidirectional
+    // DShot is active low
+    uint32_t bitTicks = DSHOT_RMT_TICKS_PER_SECOND / ((uint32_t)mode * 1000);
+    uint32_t active = bidirectional ? 0 : 1;
+
+    bit1.level0 = active;
+    bit1.duration0 = bitTicks * 3 / 4;
+    bit1.level1 = !active;
+    bit1.duration1 = bitTicks - bit1.duration0;
+
+    bit0.level0 = active;
+    bit0.duration0 = bitTicks * 3 / 8;
+    bit0.level1 = !active;
+    bit0.duration1 = bitTicks - bit0.duration0;
+
+    // The reply comes back at 5/4 of the command bit rate
+    telemetryBitTicks = bitTicks * 4 / 5;
+
+    this->pin = pin;
+    channels[index] = this;
+
+    if (bidirectional && !attachReceiver())
+    {
+        Serial.println("ERROR configuring DShot telemetry on pin " + String(pin));
+        detach();
+        return 0;
+    }
+
+    writeThrottle(0);
+    return 1;
+}
+
+bool DShot::attachReceiver()
+{
+    rxChannel = (rmt_channel_t)(channel + DSHOT_MAX_CHANNELS / 2);
+
+    rmt_config_t config = {};
+    config.rmt_mode = RMT_MODE_RX;
+    config.channel = rxChannel;
+    config.gpio_num = (gpio_num_t)pin;
+    config.mem_block_num = 1;
+    config.clk_div = DSHOT_RMT_CLOCK_DIVIDER;
+    config.rx_config.filter_en = true;
+    config.rx_config.filter_ticks_thresh = DSHOT_RX_FILTER_TICKS;
+    // Longer than any run in a reply, shorter than the gap between our frame and the reply
+    config.rx_config.idle_threshold = telemetryBitTicks * 5;
+
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(rxChannel, DSHOT_RX_BUFFER_SIZE, 0) != ESP_OK)
+    {
+        return false;
+    }
+
+    receivers[rxChannel] = true;
+
+    // Both channels share the pin: open drain with pull-up, so the ESC can
+    // pull the line low while we idle high
+    gpio_set_direction((gpio_num_t)pin, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_pullup_en((gpio_num_t)pin);
+
+    if (rmt_get_ringbuf_handle(rxChannel, &ringbuffer) != ESP_OK || rmt_rx_start(rxChannel, true) != ESP_OK)
+    {
+        return false;
+    }
+
+    if (telemetryTaskHandle == NULL)
+    {
+        xTaskCreatePinnedToCore(telemetryTask, "dshot_telemetry", DSHOT_TELEMETRY_TASK_STACK, NULL, 1,
+                                &telemetryTaskHandle, DSHOT_TELEMETRY_TASK_CORE);
+    }
+
+    return true;
+}
+
+void DShot::detach()
+{
+    if (!attached())
+    {
+        return;
+    }
+
+    if (bidirectional && receivers[rxChannel])
+    {
+        rmt_rx_stop(rxChannel);
+        rmt_driver_uninstall(rxChannel);
+        receivers[rxChannel] = false;
+        ringbuffer = NULL;
+    }
+
+    rmt_driver_uninstall(channel);
+    channels[channel] = NULL;
+    pin = -1;
+}
+
+bool DShot::attached()
+{
+    return pin >= 0;
+}
+
+void DShot::write(int value)
+{
+    if (value <= 0)
+    {
+        writeThrottle(0);
+        return;
+    }
+
+    if (value > 180)
+    {
+        value = 180;
+    }
+
+    writeThrottle(DSHOT_THROTTLE_MIN + (value * (DSHOT_THROTTLE_MAX - DSHOT_THROTTLE_MIN) + 90) / 180);
+}
+
+void DShot::writeThrottle(uint16_t throttle, bool telemetry)
+{
+    if (throttle > DSHOT_THROTTLE_MAX)
+    {
+        throttle = DSHOT_THROTTLE_MAX;
+    }
+
+    uint16_t frame = (throttle << 1) | (telemetry ? 1 : 0);
+    uint16_t crc = frame ^ (frame >> 4) ^ (frame >> 8);
+
+    // Bidirectional ESCs expect the inverted checksum
+    if (bidirectional)
+    {
+        crc = ~crc;
+    }
+
+    frame = (frame << 4) | (crc & 0x0F);
+
+    for (int i = 0; i < DSHOT_FRAME_BITS; i++)
+    {
+        items[i] = (frame & (0x8000 >> i)) ? bit1 : bit0;
+    }
+
+    items[DSHOT_FRAME_BITS].val = 0;
+}
+
+void DShot::fill()
+{
+    rmt_fill_tx_items(channel, items, DSHOT_FRAME_BITS + 1, 0);
+}
+
+void DShot::send()
+{
+    if (!attached())
+    {
+        return;
+    }
+
+    fill();
+    rmt_tx_start(channel, true);
+}
+
+// Load every channel first so the starts land within a few cycles of each other
+void DShot::sendAll()
+{
+    for (int i = 0; i < DSHOT_MAX_CHANNELS; i++)
+    {
+        if (channels[i] != NULL)
+        {
+            channels[i]->fill();
+        }
+    }
+
+    for (int i = 0; i < DSHOT_MAX_CHANNELS; i++)
+    {
+        if (channels[i] != NULL)
+        {
+            rmt_tx_start(channels[i]->channel, true);
+        }
+    }
+}
+
+bool DShot::readErpm(uint32_t &erpm)
+{
+    if (!bidirectional || telemetryFrames == 0 || millis() - erpmTimestamp > DSHOT_TELEMETRY_TIMEOUT_MS)
+    {
+        return false;
+    }
+
+    erpm = this->erpm;
+    return true;
+}
+
+/*
+ * A reply is 21 bits where every level change is a 1, so each run of n bit
+ * times is a 1 followed by n - 1 zeros. The last run blends into the idle
+ * high and is whatever is left of the 21 bits. The result decodes to 4 GCR
+ * nibbles: 12 bits of period (3 bit shift, 9 bit mantissa, in us) and a
+ * 4 bit checksum.
+ *
+ * Our own command frame is seen by the receiver too; with 32 runs it can
+ * never fit in 21 bits, so it is dropped here as well.
+ */
+bool DShot::decodeTelemetry(const rmt_item32_t *received, size_t count, uint32_t bitTicks, uint32_t &erpm)
+{
+    uint32_t value = 0;
+    int bits = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t durations[2] = {received[i].duration0, received[i].duration1};
+
+        for (int j = 0; j < 2; j++)
+        {
+            if (durations[j] == 0)
+            {
+                break;
+            }
+
+            int length = (durations[j] + bitTicks / 2) / bitTicks;
+            if (length < 1)
+            {
+                length = 1;
+            }
+
+            bits += length;
+            if (bits >= DSHOT_TELEMETRY_BITS)
+            {
+                return false;
+            }
+
+            value = (value << length) | (1 << (length - 1));
+        }
+
+        if (received[i].duration0 == 0 || received[i].duration1 == 0)
+        {
+            break;
+        }
+    }
+
+    if (bits == 0)
+    {
+        return false;
+    }
+
+    int remaining = DSHOT_TELEMETRY_BITS - bits;
+    value = (value << remaining) | (1 << (remaining - 1));
+
+    // Transitions back to GCR, then GCR to nibbles
+    value ^= value >> 1;
+
+    uint32_t decoded = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t nibble = GCR_TO_NIBBLE[(value >> (i * 5)) & 0x1F];
+        if (nibble == 0xFF)
+        {
+            return false;
+        }
+
+        decoded |= nibble << (i * 4);
+    }
+
+    // XOR of all four nibbles, checksum included, is 0xF
+    uint32_t crc = decoded ^ (decoded >> 8);
+    crc ^= crc >> 4;
+    if ((crc & 0x0F) != 0x0F)
+    {
+        return false;
+    }
+
+    decoded >>= 4;
+
+    // Longest period the ESC can report means the motor is stopped
+    if (decoded == 0x0FFF)
+    {
+        erpm = 0;
+        return true;
+    }
+
+    uint32_t periodUs = (decoded & 0x1FF) << (decoded >> 9);
+    if (periodUs == 0)
+    {
+        return false;
+    }
+
+    erpm = 60000000 / periodUs;
+    return true;
+}
+
+void DShot::receive()
+{
+    size_t length = 0;
+    rmt_item32_t *received;
+
+    while ((received = (rmt_item32_t *)xRingbufferReceive(ringbuffer, &length, 0)) != NULL)
+    {
+        uint32_t decoded;
+        size_t count = length / sizeof(rmt_item32_t);
+
+        // Anything longer than a reply can hold is the echo of our own frame
+        if (count <= DSHOT_TELEMETRY_BITS / 2 + 1)
+        {
+            if (decodeTelemetry(received, count, telemetryBitTicks, decoded))
+            {
+                erpm = decoded;
+                erpmTimestamp = millis();
+                telemetryFrames++;
+            }
+            else
+            {
+                telemetryErrors++;
+            }
+        }
+
+        vRingbufferReturnItem(ringbuffer, received);
+    }
+}
+
+void DShot::telemetryTask(void *arg)
+{
+    for (;;)
+    {
+        for (int i = 0; i < DSHOT_MAX_CHANNELS; i++)
+        {
+            DShot *dshot = channels[i];
+            if (dshot != NULL && dshot->bidirectional && dshot->ringbuffer != NULL)
+            {
+                dshot->receive();
+            }
+        }
+
+        vTaskDelay(1);
+    }
+}
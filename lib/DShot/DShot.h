@@ -0,0 +1,91 @@
+/*
+ * DShot.h
+ *
+ * DShot150/300/600 ESC output on the ESP32 RMT peripheral. Throttle goes in
+ * through writeThrottle() as a raw value, 48..2047 for the 2000 throttle
+ * steps and 0 to stop; callers with a continuous command should map it onto
+ * that range themselves. write(int 0..180) mirrors Servo for quick tests but
+ * only reaches 181 of those steps.
+ *
+ * The two bit symbols are computed once at attach(); a write only picks one
+ * of them per bit, and the RMT clocks the frame out with no CPU involvement.
+ * write() just prepares the frame; send() or sendAll() puts it on the wire,
+ * sendAll() starting every attached channel back to back.
+ *
+ * Bidirectional mode inverts the line and listens on it with a second RMT
+ * channel for the ESC's GCR coded eRPM reply. Replies are decoded by a low
+ * priority task on the other core, so the caller only ever reads the latest
+ * value with readErpm().
+ */
+
+#ifndef DSHOT_H_
+#define DSHOT_H_
+
+#include <Arduino.h>
+#include "driver/rmt.h"
+
+#define DSHOT_MAX_CHANNELS 8
+#define DSHOT_FRAME_BITS 16
+#define DSHOT_THROTTLE_MIN 48
+#define DSHOT_THROTTLE_MAX 2047
+#define DSHOT_TELEMETRY_BITS 21
+#define DSHOT_TELEMETRY_TIMEOUT_MS 100 // readErpm() reports no data after this long without a valid reply
+
+enum DShotMode
+{
+    DSHOT150 = 150,
+    DSHOT300 = 300,
+    DSHOT600 = 600
+};
+
+class DShot
+{
+public:
+    DShot(DShotMode mode = DSHOT600, bool bidirectional = false);
+    ~DShot();
+
+    int attach(int pin); // returns 1 on success, 0 on failure, like Servo
+    void detach();
+    bool attached();
+
+    void write(int value);                                         // coarse 0..180 like Servo::write, 0 stops the motor
+    void writeThrottle(uint16_t throttle, bool telemetry = false); // raw DShot value 0..2047
+
+    void send();
+    static void sendAll();
+
+    // Bidirectional mode only: latest electrical RPM, false if no valid reply lately
+    bool readErpm(uint32_t &erpm);
+    uint32_t getTelemetryFrames() { return telemetryFrames; }
+    uint32_t getTelemetryErrors() { return telemetryErrors; }
+
+    static bool decodeTelemetry(const rmt_item32_t *received, size_t count, uint32_t bitTicks, uint32_t &erpm);
+
+private:
+    void fill();
+    bool attachReceiver();
+    void receive();
+    static void telemetryTask(void *arg);
+
+    static DShot *channels[DSHOT_MAX_CHANNELS];
+    static bool receivers[DSHOT_MAX_CHANNELS]; // channels taken by a bidirectional receiver
+    static TaskHandle_t telemetryTaskHandle;
+
+    DShotMode mode;
+    bool bidirectional;
+    int pin = -1;
+    rmt_channel_t channel = RMT_CHANNEL_0;
+    rmt_channel_t rxChannel = RMT_CHANNEL_0;
+    RingbufHandle_t ringbuffer = NULL;
+    rmt_item32_t bit0, bit1;
+    rmt_item32_t items[DSHOT_FRAME_BITS + 1]; // frame plus end marker
+    uint32_t telemetryBitTicks = 0;
+
+    // Written by the telemetry task, read by the control task
+    volatile uint32_t erpm = 0;
+    volatile uint32_t erpmTimestamp = 0; // millis() of the last valid reply
+    volatile uint32_t telemetryFrames = 0;
+    volatile uint32_t telemetryErrors = 0;
+};
+
+#endif
@@ -7,6 +7,14 @@
 
 #include <ESP32PWM.h>
 #include "esp32-hal-ledc.h"
+#include "driver/ledc.h"
+#include "soc/ledc_struct.h"
+
+// Portion of the period (1/2^n) before the rollover in which writeGroup waits
+// for the next period instead of risking a split update
+#define GROUP_GUARD_SHIFT 4
+
+static portMUX_TYPE groupMux = portMUX_INITIALIZER_UNLOCKED;
 
 // initialize the class variable ServoCount
 int ESP32PWM::PWMCount = -1;              // the total number of attached servos
@@ -33,6 +41,63 @@ void ESP32PWM::allocateTimer(int timerNumber){
 	ESP32PWM::timerCount[timerNumber]=0;
 }
 
+void ESP32PWM::resetTimer(int timerNumber){
+	if(timerNumber<0 || timerNumber>3)
+		return;
+	// ledc 0-7 run from the group 0 timers, ledc 8-15 from the group 1 timers;
+	// the two resets land a few bus cycles apart
+	for (int group = 0; group < LEDC_SPEED_MODE_MAX; group++)
+		ledc_timer_rst((ledc_mode_t) group, (ledc_timer_t) timerNumber);
+}
+
+// true while pwm's timer is in the last 1/2^GROUP_GUARD_SHIFT of its period
+static bool inGuard(int group, int timer, uint8_t resolutionBits) {
+	uint32_t period = 1 << resolutionBits;
+	return LEDC.timer_group[group].timer[timer].value.timer_cnt
+			>= period - (period >> GROUP_GUARD_SHIFT);
+}
+
+void ESP32PWM::writeGroup(ESP32PWM * const * pwms, const uint32_t * duties,
+		int count) {
+	if (count <= 0)
+		return;
+	for (;;) {
+		// duty updates latch at the rollover; if it is close on any of the
+		// timers involved (channels 0-7 and 8-15 sit in different groups),
+		// let it pass first. This spins with interrupts enabled.
+		for (int i = 0; i < count; i++) {
+			int group = pwms[i]->ledcGroup;
+			int timer = pwms[i]->timerNum;
+			if (inGuard(group, timer, pwms[i]->resolutionBits)) {
+				uint32_t last = 0;
+				uint32_t counter;
+				while ((counter = LEDC.timer_group[group].timer[timer].value.timer_cnt) >= last)
+					last = counter;
+			}
+		}
+
+		portENTER_CRITICAL(&groupMux);
+		// preempted into the guard window after the wait: go round again
+		bool late = false;
+		for (int i = 0; i < count && !late; i++)
+			late = inGuard(pwms[i]->ledcGroup, pwms[i]->timerNum,
+					pwms[i]->resolutionBits);
+		if (!late) {
+			for (int i = 0; i < count; i++) {
+				pwms[i]->myDuty = duties[i];
+				ledc_set_duty((ledc_mode_t) pwms[i]->ledcGroup,
+						(ledc_channel_t) pwms[i]->ledcIndex, duties[i]);
+			}
+			for (int i = 0; i < count; i++)
+				ledc_update_duty((ledc_mode_t) pwms[i]->ledcGroup,
+						(ledc_channel_t) pwms[i]->ledcIndex);
+		}
+		portEXIT_CRITICAL(&groupMux);
+		if (!late)
+			return;
+	}
+}
+
 ESP32PWM::ESP32PWM() {
 	resolutionBits = 8;
 	pwmChannel = -1;
@@ -90,6 +155,8 @@ int ESP32PWM::allocatenext(double freq) {
 					if ((myTimerNumber >= 0)  && (!ChannelUsed[myTimerNumber]))
 					{
 						pwmChannel = myTimerNumber;
+						ledcGroup = pwmChannel / 8;
+						ledcIndex = pwmChannel % 8;
 // 						Serial.println(
 // 							"PWM on ledc channel #" + String(pwmChannel)
 // 									+ " using 'timer " + String(timerNum)
@@ -152,12 +219,12 @@ double ESP32PWM::setup(double freq, uint8_t resolution_bits) {
 	}
 	return ledcSetup(getChannel(), freq, resolution_bits);
 }
-double ESP32PWM::getDutyScaled() {
-	return mapf((double) myDuty, 0, (double) ((1 << resolutionBits) - 1), 0.0,
-			1.0);
+float ESP32PWM::getDutyScaled() {
+	return mapf((float) myDuty, 0.0f, (float) ((1 << resolutionBits) - 1), 0.0f,
+			1.0f);
 }
-void ESP32PWM::writeScaled(double duty) {
-	write(mapf(duty, 0.0, 1.0, 0, (double) ((1 << resolutionBits) - 1)));
+void ESP32PWM::writeScaled(float duty) {
+	write(mapf(duty, 0.0f, 1.0f, 0.0f, (float) ((1 << resolutionBits) - 1)));
 }
 void ESP32PWM::write(uint32_t duty) {
 	myDuty = duty;
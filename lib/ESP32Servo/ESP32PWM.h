@@ -19,6 +19,8 @@ private:
 
 	void attach(int pin);
 	int pwmChannel = 0;                         // channel number for this servo
+	uint8_t ledcGroup = 0;                      // pwmChannel split into group / channel, set at allocation
+	uint8_t ledcIndex = 0;
 	bool attachedState = false;
 	int pin;
 	uint8_t resolutionBits;
@@ -31,8 +33,8 @@ private:
 	bool checkFrequencyForSideEffects(double freq);
 
 	void adjustFrequencyLocal(double freq, double dutyScaled);
-	static double mapf(double x, double in_min, double in_max, double out_min,
-			double out_max) {
+	static float mapf(float x, float in_min, float in_max, float out_min,
+			float out_max) {
 		if(x>in_max)
 			return out_max;
 		if(x<in_min)
@@ -60,7 +62,7 @@ public:
 	// write raw duty cycle
 	void write(uint32_t duty);
 	// Write a duty cycle to the PWM using a unit vector from 0.0-1.0
-	void writeScaled(double duty);
+	void writeScaled(float duty);
 	//Adjust frequency
 	double writeTone(double freq);
 	double writeNote(note_t note, uint8_t octave);
@@ -69,7 +71,7 @@ public:
 	// Read pwm data
 	uint32_t read();
 	double readFreq();
-	double getDutyScaled();
+	float getDutyScaled();
 
 	//Timer data
 	static int timerAndIndexToChannel(int timer, int index);
@@ -80,6 +82,23 @@ public:
 	 *
 	 */
 	static void allocateTimer(int timerNumber);
+	/**
+	 * resetTimer
+	 * @param a timer number 0-3
+	 * Restart the counter of this timer in both LEDC groups at once, so every
+	 * channel it drives starts its period on the same edge
+	 */
+	static void resetTimer(int timerNumber);
+	/**
+	 * writeGroup
+	 * @param pwms attached channels, all on the same timer
+	 * @param duties raw duty per channel
+	 * Wait, with interrupts enabled, until every channel's timer (in either
+	 * LEDC group) is clear of the end of its period, then commit all duties
+	 * in one short critical section so they latch on the same boundary
+	 */
+	static void writeGroup(ESP32PWM * const * pwms, const uint32_t * duties,
+			int count);
 	static bool explicateAllocationMode;
 	int getTimer() {
 		return timerNum;
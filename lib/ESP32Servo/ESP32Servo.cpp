@@ -117,13 +117,70 @@ int Servo::attach(int pin, int min, int max)
             max = MAX_PULSE_WIDTH;
         this->min = min;     //store this value in uS
         this->max = max;    //store this value in uS
+        this->protocol = SERVO_PWM;
+        this->minNs = min * 1000;
+        this->maxNs = max * 1000;
         // Set up this channel
         // if you want anything other than default timer width, you must call setTimerWidth() before attach
         pwm.attachPin(this->pinNumber,REFRESH_CPS, this->timer_width );   // GPIO pin assigned to channel
+        updatePulseTicks();
         //Serial.println("Attaching servo : "+String(pin)+" on PWM "+String(pwm.getChannel()));
         return 1;
 }
 
+int Servo::attach(int pin, ServoProtocol protocol, int hertz)
+{
+    // min / max pulse per protocol in ns, SERVO_PWM uses the 1000-2000us ESC range
+    static const int PULSE_NS[][2] = {
+        {1000000, 2000000}, // SERVO_PWM
+        {125000, 250000},   // ONESHOT125
+        {42000, 84000},     // ONESHOT42
+        {5000, 25000}       // MULTISHOT
+    };
+
+    if (this->attached())
+        this->detach();
+
+    this->protocol = protocol;
+    this->minNs = PULSE_NS[protocol][0];
+    this->maxNs = PULSE_NS[protocol][1];
+
+    // the period has to fit the longest pulse plus some low time
+    int maxHertz = 1000000000 / (this->maxNs + this->maxNs / 4);
+    if (hertz > maxHertz)
+    {
+        Serial.println("Servo refresh " + String(hertz) + "Hz too fast for the protocol, using " + String(maxHertz) + "Hz");
+        hertz = maxHertz;
+    }
+    REFRESH_CPS = hertz;
+
+    // widest timer that still fits the LEDC source clock at this refresh rate
+    int width = DEFAULT_TIMER_WIDTH;
+    while (width > 1 && ((int64_t)hertz << width) > LEDC_SOURCE_CLOCK_HZ)
+        width--;
+    this->timer_width = width;
+    this->timer_width_ticks = 1 << width;
+
+    if (!pwm.hasPwm(pin))
+    {
+        Serial.println("This pin can not be an ESC: " + String(pin));
+        return 0;
+    }
+
+    this->pinNumber = pin;
+    this->min = this->minNs / 1000;         // whole us, for writeMicroseconds() / read()
+    this->max = (this->maxNs + 999) / 1000;
+    this->ticks = 0;
+
+    pwm.attachPin(this->pinNumber, REFRESH_CPS, this->timer_width);
+    updatePulseTicks();
+    this->writeTicks(this->minTicks);
+
+    // all channels on this timer restart together, so their pulses rise on the same edge
+    ESP32PWM::resetTimer(pwm.getTimer());
+    return 1;
+}
+
 void Servo::detach()
 {
     if (this->attached())
@@ -137,6 +194,18 @@ void Servo::detach()
 
 void Servo::write(int value)
 {
+    // ESC protocols map the angle straight onto the pulse in ticks
+    if (this->protocol != SERVO_PWM)
+    {
+        if (value < 0)
+            value = 0;
+        else if (value > 180)
+            value = 180;
+
+        this->writeTicks(this->minTicks + (value * (this->maxTicks - this->minTicks) + 90) / 180);
+        return;
+    }
+
     // treat values less than MIN_PULSE_WIDTH (500) as angles in degrees (valid values in microseconds are handled as microseconds)
     if (value < MIN_PULSE_WIDTH)
     {
@@ -167,6 +236,49 @@ void Servo::writeMicroseconds(int value)
     }
 }
 
+void Servo::writeTicks(int value)
+{
+    if (this->attached())
+    {
+        if (value < this->minTicks)
+            value = this->minTicks;
+        else if (value > this->maxTicks)
+            value = this->maxTicks;
+
+        this->ticks = value;
+        pwm.write(this->ticks);
+    }
+}
+
+void Servo::writeScaled(float value)
+{
+    this->writeTicks(scaledToTicks(value));
+}
+
+void Servo::writeScaledGroup(Servo * const * servos, const float * values, int count)
+{
+    ESP32PWM * pwms[MAX_SERVOS];
+    uint32_t duties[MAX_SERVOS];
+    int attachedCount = 0;
+
+    if (count > MAX_SERVOS)
+        count = MAX_SERVOS;
+
+    // everything is computed before the critical section, which only stores registers
+    for (int i = 0; i < count; i++)
+    {
+        if (!servos[i]->attached())
+            continue;
+
+        servos[i]->ticks = servos[i]->scaledToTicks(values[i]);
+        pwms[attachedCount] = &servos[i]->pwm;
+        duties[attachedCount] = servos[i]->ticks;
+        attachedCount++;
+    }
+
+    ESP32PWM::writeGroup(pwms, duties, attachedCount);
+}
+
 int Servo::read() // return the value as degrees
 {
     return (map(readMicroseconds()+1, this->min, this->max, 0, 180));
@@ -223,6 +335,7 @@ void Servo::setTimerWidth(int value)
     	pwm.detachPin(this->pinNumber);
     	pwm.attachPin(this->pinNumber, REFRESH_CPS, this->timer_width);
     }        
+    updatePulseTicks();
 }
 
 int Servo::readTimerWidth()
@@ -232,12 +345,34 @@ int Servo::readTimerWidth()
 
 int Servo::usToTicks(int usec)
 {
-    return (int)((double)usec / ((double)REFRESH_USEC / (double)this->timer_width_ticks)*(((double)REFRESH_CPS)/50.0));
+    // usec * ticks_per_period / period_usec, in integer math (no soft-float double)
+    return (int)(((int64_t)usec * this->timer_width_ticks * REFRESH_CPS) / 1000000);
+}
+
+int Servo::nsToTicks(int64_t nsec)
+{
+    return (int)((nsec * this->timer_width_ticks * REFRESH_CPS) / 1000000000);
+}
+
+int Servo::scaledToTicks(float value)
+{
+    if (value < 0.0f)
+        value = 0.0f;
+    else if (value > 1.0f)
+        value = 1.0f;
+
+    return this->minTicks + (int)(value * (float)(this->maxTicks - this->minTicks) + 0.5f);
+}
+
+void Servo::updatePulseTicks()
+{
+    this->minTicks = nsToTicks(this->minNs);
+    this->maxTicks = nsToTicks(this->maxNs);
 }
 
 int Servo::ticksToUs(int ticks)
 {
-    return (int)((double)ticks * ((double)REFRESH_USEC / (double)this->timer_width_ticks)/(((double)REFRESH_CPS)/50.0));
+    return (int)(((int64_t)ticks * 1000000) / ((int64_t)this->timer_width_ticks * REFRESH_CPS));
 }
 
  
@@ -95,6 +95,24 @@
 
 #define MAX_SERVOS              16     // no. of PWM channels in ESP32
 
+#define LEDC_SOURCE_CLOCK_HZ 80000000 // APB clock feeding the LEDC timers
+
+/*
+ * ESC protocols. SERVO_PWM is the classic 50 Hz servo pulse bounded by min/max;
+ * the others are the short "analog" ESC pulses, in nanoseconds:
+ *   ONESHOT125  125000 - 250000
+ *   ONESHOT42    42000 -  84000
+ *   MULTISHOT     5000 -  25000
+ * For those the refresh rate should follow the control loop, and the pulse
+ * is computed straight in timer ticks since a microsecond is too coarse.
+ */
+enum ServoProtocol {
+	SERVO_PWM = 0,
+	ONESHOT125,
+	ONESHOT42,
+	MULTISHOT
+};
+
 /*
  * This group/channel/timmer mapping is for information only;
  * the details are handled by lower-level code
@@ -125,9 +143,14 @@ public:
 	// Arduino Servo Library calls
 	int attach(int pin); // attach the given pin to the next free channel, returns channel number or 0 if failure
 	int attach(int pin, int min, int max); // as above but also sets min and max values for writes.
+	int attach(int pin, ServoProtocol protocol, int hertz); // ESC protocol refreshed at hertz, e.g. the control loop rate
 	void detach();
 	void write(int value); // if value is < MIN_PULSE_WIDTH its treated as an angle, otherwise as pulse width in microseconds
 	void writeMicroseconds(int value);     // Write pulse width in microseconds
+	void writeTicks(int value);            // Write pulse width in timer ticks, clamped to the min/max pulse
+	void writeScaled(float value);         // 0.0-1.0 of the min..max pulse, computed in ticks
+	// writeScaled for several servos on one timer, committed together in the same PWM period
+	static void writeScaledGroup(Servo * const * servos, const float * values, int count);
 	int read(); // returns current pulse width as an angle between 0 and 180 degrees
 	int readMicroseconds(); // returns current pulse width in microseconds for this servo
 	bool attached(); // return true if this servo is attached, otherwise false
@@ -135,6 +158,12 @@ public:
 	// ESP32 only functions
 	void setTimerWidth(int value);     // set the PWM timer width (ESP32 ONLY)
 	int readTimerWidth();              // get the PWM timer width (ESP32 ONLY)
+	ServoProtocol readProtocol() {
+		return protocol;
+	}
+	int getChannel() {                 // LEDC channel, valid once attached
+		return pwm.getChannel();
+	}
 	void setPeriodHertz(int hertz){
 		REFRESH_CPS=hertz;
 		setTimerWidth(this->timer_width);
@@ -142,6 +171,9 @@ public:
 private:
 	int usToTicks(int usec);
 	int ticksToUs(int ticks);
+	int nsToTicks(int64_t nsec);
+	int scaledToTicks(float value);
+	void updatePulseTicks();
 //   static int ServoCount;                             // the total number of attached servos
 //   static int ChannelUsed[];                          // used to track whether a channel is in service
 //   int servoChannel = 0;                              // channel number for this servo
@@ -155,6 +187,11 @@ private:
 	ESP32PWM * getPwm(); // get the PWM object
 	ESP32PWM pwm;
 	int REFRESH_CPS = 50;
+	ServoProtocol protocol = SERVO_PWM;
+	int minNs = DEFAULT_uS_LOW * 1000;    // minimum pulse width in ns, source of minTicks
+	int maxNs = DEFAULT_uS_HIGH * 1000;   // maximum pulse width in ns, source of maxTicks
+	int minTicks = 0;                     // min pulse in ticks at the current width / refresh
+	int maxTicks = 0;                     // max pulse in ticks at the current width / refresh
 
 };
 #endif
@@ -29,6 +29,10 @@
 #include <Hash.h>
 #endif
 
+#ifdef ESP32
+#include "esp_wifi.h"
+#endif
+
 #define MAX_PRINTF_LEN 64
 
 size_t webSocketSendFrameWindow(AsyncClient *client){
@@ -63,11 +67,7 @@ size_t webSocketSendFrame(AsyncClient *client, bool final, uint8_t opcode, bool
 
   if(len > space) len = space;
 
-  uint8_t *buf = (uint8_t*)malloc(headLen);
-  if(buf == NULL){
-    //os_printf("could not malloc %u bytes for frame header\n", headLen);
-    return 0;
-  }
+  uint8_t buf[8];
 
   buf[0] = opcode & 0x0F;
   if(final)
@@ -85,10 +85,8 @@ size_t webSocketSendFrame(AsyncClient *client, bool final, uint8_t opcode, bool
   }
   if(client->add((const char *)buf, headLen) != headLen){
     //os_printf("error adding %lu header bytes\n", headLen);
-    free(buf);
     return 0;
   }
-  free(buf);
 
   if(len){
     if(len && mask){
@@ -109,6 +107,65 @@ size_t webSocketSendFrame(AsyncClient *client, bool final, uint8_t opcode, bool
 }
 
 
+typedef uint32_t __attribute__((__may_alias__)) ws_word_t;
+
+//XORs len bytes with the mask, offset being the position of data[0] in the frame payload
+static void webSocketUnmask(uint8_t *data, size_t len, const uint8_t *mask, size_t offset){
+  size_t i = 0;
+  while(i < len && ((uintptr_t)(data + i) & 3)){
+    data[i] ^= mask[(offset + i) & 3];
+    i++;
+  }
+  if(len - i >= 4){
+    //mask rotated to line up with the aligned words
+    uint8_t rotated[4];
+    for(size_t k = 0; k < 4; k++)
+      rotated[k] = mask[(offset + i + k) & 3];
+    ws_word_t key;
+    memcpy(&key, rotated, 4);
+    ws_word_t *word = (ws_word_t *)(data + i);
+    for(; len - i >= 4; i += 4)
+      *word++ ^= key;
+  }
+  while(i < len){
+    data[i] ^= mask[(offset + i) & 3];
+    i++;
+  }
+}
+
+//parses the frame header at data, returns its length or 0 if it doesn't fit in plen
+static size_t webSocketParseHeader(const uint8_t *data, size_t plen, AwsFrameInfo *info){
+  if(plen < 2)
+    return 0;
+  size_t headLen = 2;
+  info->index = 0;
+  info->final = (data[0] & 0x80) != 0;
+  info->opcode = data[0] & 0x0F;
+  info->masked = (data[1] & 0x80) != 0;
+  info->len = data[1] & 0x7F;
+  if(info->len == 126){
+    if(plen < 4)
+      return 0;
+    info->len = data[3] | (uint16_t)(data[2]) << 8;
+    headLen += 2;
+  } else if(info->len == 127){
+    if(plen < 10)
+      return 0;
+    info->len = 0;
+    for(int i = 2; i < 10; i++)
+      info->len = (info->len << 8) | data[i];
+    headLen += 8;
+  }
+  if(info->masked){
+    if(plen < headLen + 4)
+      return 0;
+    memcpy(info->mask, data + headLen, 4);
+    headLen += 4;
+  }
+  return headLen;
+}
+
+
 /*
  *    AsyncWebSocketMessageBuffer
  */
@@ -457,6 +514,85 @@ AsyncWebSocketMultiMessage::~AsyncWebSocketMultiMessage() {
 }
 
 
+/*
+ * Slot Message
+ */
+
+void AsyncWebSocketSlotMessage::assign(const char * data, size_t len, uint8_t opcode, bool mask){
+  _opcode = opcode & 0x07;
+  _mask = mask;
+  _len = (len > WS_SLOT_PAYLOAD) ? WS_SLOT_PAYLOAD : len;
+  _sent = 0;
+  _ack = 0;
+  _acked = 0;
+  _inUse = true;
+  _status = WS_MSG_SENDING;
+  memcpy(_frame + WS_SLOT_HEADROOM, data, _len);
+}
+
+void AsyncWebSocketSlotMessage::ack(size_t len, uint32_t time)  {
+  (void)time;
+  _acked += len;
+  if(_sent == _len && _acked == _ack){
+    _status = WS_MSG_SENT;
+  }
+}
+
+size_t AsyncWebSocketSlotMessage::send(AsyncClient *client)  {
+  if(_status != WS_MSG_SENDING)
+    return 0;
+  if(_acked < _ack){
+    return 0;
+  }
+  if(_sent == _len){
+    if(_acked == _ack)
+      _status = WS_MSG_SENT;
+    return 0;
+  }
+
+  size_t toSend = _len - _sent;
+  size_t window = webSocketSendFrameWindow(client);
+  uint8_t *payload = _frame + WS_SLOT_HEADROOM;
+
+  if(!_sent && !_mask && window >= toSend){
+    //whole message in one frame, header written in place in front of the payload
+    uint8_t headLen = (_len < 126) ? 2 : 4;
+    uint8_t *frame = payload - headLen;
+    frame[0] = 0x80 | _opcode;
+    if(_len < 126)
+      frame[1] = _len;
+    else {
+      frame[1] = 126;
+      frame[2] = (uint8_t)((_len >> 8) & 0xFF);
+      frame[3] = (uint8_t)(_len & 0xFF);
+    }
+    if(client->add((const char *)frame, headLen + _len) != headLen + _len || !client->send())
+      return 0;
+    _sent = _len;
+    _ack = headLen + _len;
+    return _len;
+  }
+
+  if(window < toSend) {
+      toSend = window;
+  }
+
+  _sent += toSend;
+  _ack += toSend + ((toSend < 126)?2:4) + (_mask * 4);
+
+  bool final = (_sent == _len);
+  uint8_t* dPtr = payload + (_sent - toSend);
+  uint8_t opCode = (toSend && _sent == toSend)?_opcode:(uint8_t)WS_CONTINUATION;
+
+  size_t sent = webSocketSendFrame(client, final, opCode, _mask, dPtr, toSend);
+  if(toSend && sent != toSend){
+      _sent -= (toSend - sent);
+      _ack -= (toSend - sent);
+  }
+  return sent;
+}
+
+
 /*
  * Async WebSocket Client
  */
@@ -465,7 +601,11 @@ AsyncWebSocketMultiMessage::~AsyncWebSocketMultiMessage() {
 
 AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebServerRequest *request, AsyncWebSocket *server)
   : _controlQueue(LinkedList<AsyncWebSocketControl *>([](AsyncWebSocketControl *c){ delete  c; }))
-  , _messageQueue(LinkedList<AsyncWebSocketMessage *>([](AsyncWebSocketMessage *m){ delete  m; }))
+  , _messageHead(0)
+  , _messageCount(0)
+  , _assembly(NULL)
+  , _assemblyLen(0)
+  , _assemblyOverflow(false)
   , _tempObject(NULL)
 {
   _client = request->client();
@@ -475,7 +615,16 @@ AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebServerRequest *request, Async
   _pstate = 0;
   _lastMessageTime = millis();
   _keepAlivePeriod = 0;
+  _maxQueued = WS_MAX_QUEUED_MESSAGES;
+  memset(&_rtt, 0, sizeof(_rtt));
+  _rttSentAt = 0;
   _client->setRxTimeout(0);
+  if(_server->connectionProfile() == WS_PROFILE_REALTIME){
+    _client->setNoDelay(true);
+    _client->setAckTimeout(WS_REALTIME_ACK_TIMEOUT);
+    _client->setRxTimeout(WS_REALTIME_RX_TIMEOUT);
+    _maxQueued = WS_REALTIME_QUEUED_MESSAGES;
+  }
   _client->onError([](void *r, AsyncClient* c, int8_t error){ (void)c; ((AsyncWebSocketClient*)(r))->_onError(error); }, this);
   _client->onAck([](void *r, AsyncClient* c, size_t len, uint32_t time){ (void)c; ((AsyncWebSocketClient*)(r))->_onAck(len, time); }, this);
   _client->onDisconnect([](void *r, AsyncClient* c){ ((AsyncWebSocketClient*)(r))->_onDisconnect(); delete c; }, this);
@@ -488,8 +637,11 @@ AsyncWebSocketClient::AsyncWebSocketClient(AsyncWebServerRequest *request, Async
 }
 
 AsyncWebSocketClient::~AsyncWebSocketClient(){
-  _messageQueue.free();
+  while(_messageCount)
+    _popMessage();
   _controlQueue.free();
+  if(_assembly != NULL)
+    free(_assembly);
   _server->_handleEvent(this, WS_EVT_DISCONNECT, NULL, NULL, 0);
 }
 
@@ -508,35 +660,53 @@ void AsyncWebSocketClient::_onAck(size_t len, uint32_t time){
       _controlQueue.remove(head);
     }
   }
-  if(len && !_messageQueue.isEmpty()){
-    _messageQueue.front()->ack(len, time);
+  if(len && _messageCount){
+    //only acks that cover message data are RTT samples, pings and close frames are not;
+    //AsyncTCP's own time runs from its last send of anything, so it is measured here
+    uint32_t rtt = millis() - _rttSentAt;
+    _rtt.last = rtt;
+    if(!_rtt.samples || rtt < _rtt.min)
+      _rtt.min = rtt;
+    if(rtt > _rtt.max)
+      _rtt.max = rtt;
+    _rtt.smoothed = _rtt.samples ? (_rtt.smoothed * 7 + rtt) / 8 : rtt;
+    _rtt.samples++;
+    _frontMessage()->ack(len, time);
   }
   _server->_cleanBuffers(); 
   _runQueue();
 }
 
 void AsyncWebSocketClient::_onPoll(){
-  if(_client->canSend() && (!_controlQueue.isEmpty() || !_messageQueue.isEmpty())){
+  if(_client->canSend() && (!_controlQueue.isEmpty() || _messageCount)){
     _runQueue();
-  } else if(_keepAlivePeriod > 0 && _controlQueue.isEmpty() && _messageQueue.isEmpty() && (millis() - _lastMessageTime) >= _keepAlivePeriod){
+  } else if(_keepAlivePeriod > 0 && _controlQueue.isEmpty() && !_messageCount && (millis() - _lastMessageTime) >= _keepAlivePeriod){
     ping((uint8_t *)AWSC_PING_PAYLOAD, AWSC_PING_PAYLOAD_LEN);
   }
 }
 
+void AsyncWebSocketClient::_popMessage(){
+  _messageQueue[_messageHead]->release();
+  _messageHead = (_messageHead + 1) % WS_MAX_QUEUED_MESSAGES;
+  _messageCount--;
+}
+
 void AsyncWebSocketClient::_runQueue(){
-  while(!_messageQueue.isEmpty() && _messageQueue.front()->finished()){
-    _messageQueue.remove(_messageQueue.front());
+  while(_messageCount && _frontMessage()->finished()){
+    _popMessage();
   }
 
-  if(!_controlQueue.isEmpty() && (_messageQueue.isEmpty() || _messageQueue.front()->betweenFrames()) && webSocketSendFrameWindow(_client) > (size_t)(_controlQueue.front()->len() - 1)){
+  if(!_controlQueue.isEmpty() && (!_messageCount || _frontMessage()->betweenFrames()) && webSocketSendFrameWindow(_client) > (size_t)(_controlQueue.front()->len() - 1)){
     _controlQueue.front()->send(_client);
-  } else if(!_messageQueue.isEmpty() && _messageQueue.front()->betweenFrames() && webSocketSendFrameWindow(_client)){
-    _messageQueue.front()->send(_client);
+  } else if(_messageCount && _frontMessage()->betweenFrames() && webSocketSendFrameWindow(_client)){
+    //frames go out only once the previous one is acked, so this is the oldest unacked data
+    if(_frontMessage()->send(_client))
+      _rttSentAt = millis();
   }
 }
 
 bool AsyncWebSocketClient::queueIsFull(){
-  if((_messageQueue.length() >= WS_MAX_QUEUED_MESSAGES) || (_status != WS_CONNECTED) ) return true;
+  if((_messageCount >= _maxQueued) || (_status != WS_CONNECTED) ) return true;
   return false;
 }
 
@@ -544,19 +714,34 @@ void AsyncWebSocketClient::_queueMessage(AsyncWebSocketMessage *dataMessage){
   if(dataMessage == NULL)
     return;
   if(_status != WS_CONNECTED){
-    delete dataMessage;
+    dataMessage->release();
     return;
   }
-  if(_messageQueue.length() >= WS_MAX_QUEUED_MESSAGES){
+  if(_messageCount >= _maxQueued){
       ets_printf("ERROR: Too many messages queued\n");
-      delete dataMessage;
+      dataMessage->release();
   } else {
-      _messageQueue.add(dataMessage);
+      _messageQueue[(_messageHead + _messageCount) % WS_MAX_QUEUED_MESSAGES] = dataMessage;
+      _messageCount++;
   }
   if(_client->canSend())
     _runQueue();
 }
 
+//short messages go into a free slot, anything else falls back to the heap
+void AsyncWebSocketClient::_queueData(const char * data, size_t len, uint8_t opcode){
+  if(len <= WS_SLOT_PAYLOAD){
+    for(size_t i = 0; i < WS_MESSAGE_SLOTS; i++){
+      if(!_slots[i].inUse()){
+        _slots[i].assign(data, len, opcode);
+        _queueMessage(&_slots[i]);
+        return;
+      }
+    }
+  }
+  _queueMessage(new AsyncWebSocketBasicMessage(data, len, opcode));
+}
+
 void AsyncWebSocketClient::_queueControl(AsyncWebSocketControl *controlMessage){
   if(controlMessage == NULL)
     return;
@@ -607,9 +792,55 @@ void AsyncWebSocketClient::_onDisconnect(){
   _server->_handleDisconnect(this);
 }
 
+//finds, per state channel, the last complete message that starts in this segment
+void AsyncWebSocketClient::_scanStateChannels(const uint8_t *data, size_t plen, int16_t *latest){
+  AwsFrameInfo info;
+  for(int16_t frame = 0; plen > 0; frame++){
+    size_t headLen = webSocketParseHeader(data, plen, &info);
+    if(!headLen || info.len > plen - headLen)
+      return;
+    if(info.final && info.opcode != WS_CONTINUATION && info.opcode < 8){
+      info.message_opcode = info.opcode;
+      info.num = 0;
+      int channel = _server->_stateChannel(info);
+      if(channel >= 0 && channel < WS_STATE_CHANNELS)
+        latest[channel] = frame;
+    }
+    data += headLen + info.len;
+    plen -= headLen + info.len;
+  }
+}
+
+//collects a message that didn't arrive in one piece; the buffer is allocated on first use
+void AsyncWebSocketClient::_assemble(const uint8_t *data, size_t len){
+  if(_assemblyOverflow)
+    return;
+  if(_assemblyLen + len > WS_MAX_ASSEMBLED_MESSAGE){
+    _assemblyOverflow = true;
+    return;
+  }
+  if(_assembly == NULL){
+    _assembly = (uint8_t*)malloc(WS_MAX_ASSEMBLED_MESSAGE);
+    if(_assembly == NULL){
+      _assemblyOverflow = true;
+      return;
+    }
+  }
+  memcpy(_assembly + _assemblyLen, data, len);
+  _assemblyLen += len;
+}
+
 void AsyncWebSocketClient::_onData(void *pbuf, size_t plen){
   _lastMessageTime = millis();
   uint8_t *data = (uint8_t*)pbuf;
+  int16_t latest[WS_STATE_CHANNELS];
+  int16_t frame = -1;
+  bool stateScan = !_pstate && _server->hasStateChannels();
+  if(stateScan){
+    for(int i = 0; i < WS_STATE_CHANNELS; i++)
+      latest[i] = -1;
+    _scanStateChannels(data, plen, latest);
+  }
   while(plen > 0){
     if(!_pstate){
       const uint8_t *fdata = data;
@@ -635,14 +866,27 @@ void AsyncWebSocketClient::_onData(void *pbuf, size_t plen){
         data += 4;
         plen -= 4;
       }
+
+      frame++;
+      if(stateScan && _pinfo.final && _pinfo.opcode != WS_CONTINUATION && _pinfo.opcode < 8 && _pinfo.len <= plen){
+        _pinfo.message_opcode = _pinfo.opcode;
+        _pinfo.num = 0;
+        int channel = _server->_stateChannel(_pinfo);
+        if(channel >= 0 && channel < WS_STATE_CHANNELS && latest[channel] != frame){
+          //superseded by a newer message of the same channel further on
+          _server->_stateSkip();
+          data += _pinfo.len;
+          plen -= _pinfo.len;
+          continue;
+        }
+      }
     }
 
     const size_t datalen = std::min((size_t)(_pinfo.len - _pinfo.index), plen);
     const auto datalast = data[datalen];
 
     if(_pinfo.masked){
-      for(size_t i=0;i<datalen;i++)
-        data[i] ^= _pinfo.mask[(_pinfo.index+i)%4];
+      webSocketUnmask(data, datalen, _pinfo.mask, _pinfo.index);
     }
 
     if((datalen + _pinfo.index) < _pinfo.len){
@@ -655,6 +899,8 @@ void AsyncWebSocketClient::_onData(void *pbuf, size_t plen){
         } else _pinfo.num += 1;
       }
       _server->_handleEvent(this, WS_EVT_DATA, (void *)&_pinfo, (uint8_t*)data, datalen);
+      if(_server->hasMessageHandler() && _pinfo.message_opcode < 8)
+        _assemble(data, datalen);
 
       _pinfo.index += datalen;
     } else if((datalen + _pinfo.index) == _pinfo.len){
@@ -681,7 +927,23 @@ void AsyncWebSocketClient::_onData(void *pbuf, size_t plen){
         if(datalen != AWSC_PING_PAYLOAD_LEN || memcmp(AWSC_PING_PAYLOAD, data, AWSC_PING_PAYLOAD_LEN) != 0)
           _server->_handleEvent(this, WS_EVT_PONG, NULL, data, datalen);
       } else if(_pinfo.opcode < 8){//continuation or text/binary frame
+        if(_pinfo.opcode)
+          _pinfo.message_opcode = _pinfo.opcode;
         _server->_handleEvent(this, WS_EVT_DATA, (void *)&_pinfo, data, datalen);
+        if(_server->hasMessageHandler()){
+          if(_pinfo.final && _pinfo.opcode && _pinfo.index == 0){
+            //whole message in this segment, hand out a view into it
+            _server->_handleMessage(this, _pinfo.message_opcode, data, datalen);
+          } else {
+            _assemble(data, datalen);
+            if(_pinfo.final){
+              if(!_assemblyOverflow)
+                _server->_handleMessage(this, _pinfo.message_opcode, _assembly, _assemblyLen);
+              _assemblyLen = 0;
+              _assemblyOverflow = false;
+            }
+          }
+        }
       }
     } else {
       //os_printf("frame error: len: %u, index: %llu, total: %llu\n", datalen, _pinfo.index, _pinfo.len);
@@ -761,7 +1023,7 @@ size_t AsyncWebSocketClient::printf_P(PGM_P formatP, ...) {
 #endif
 
 void AsyncWebSocketClient::text(const char * message, size_t len){
-  _queueMessage(new AsyncWebSocketBasicMessage(message, len));
+  _queueData(message, len, WS_TEXT);
 }
 void AsyncWebSocketClient::text(const char * message){
   text(message, strlen(message));
@@ -797,7 +1059,7 @@ void AsyncWebSocketClient::text(AsyncWebSocketMessageBuffer * buffer)
 }
 
 void AsyncWebSocketClient::binary(const char * message, size_t len){
-  _queueMessage(new AsyncWebSocketBasicMessage(message, len, WS_BINARY));
+  _queueData(message, len, WS_BINARY);
 }
 void AsyncWebSocketClient::binary(const char * message){
   binary(message, strlen(message));
@@ -851,10 +1113,16 @@ AsyncWebSocket::AsyncWebSocket(const String& url)
   :_url(url)
   ,_clients(LinkedList<AsyncWebSocketClient *>([](AsyncWebSocketClient *c){ delete c; }))
   ,_cNextId(1)
+  ,_maxClients(DEFAULT_MAX_WS_CLIENTS)
+  ,_profile(WS_PROFILE_DEFAULT)
+  ,_savedPowerSave(-1)
+  ,_stateSkipped(0)
   ,_enabled(true)
   ,_buffers(LinkedList<AsyncWebSocketMessageBuffer *>([](AsyncWebSocketMessageBuffer *b){ delete b; }))
 {
   _eventHandler = NULL;
+  _messageHandler = NULL;
+  _stateChannelHandler = NULL;
 }
 
 AsyncWebSocket::~AsyncWebSocket(){}
@@ -865,8 +1133,39 @@ void AsyncWebSocket::_handleEvent(AsyncWebSocketClient * client, AwsEventType ty
   }
 }
 
+void AsyncWebSocket::_handleMessage(AsyncWebSocketClient * client, uint8_t opcode, const uint8_t *data, size_t len){
+  if(_messageHandler != NULL){
+    _messageHandler(this, client, opcode, data, len);
+  }
+}
+
+int AsyncWebSocket::_stateChannel(const AwsFrameInfo &info){
+  if(!_stateChannelHandler)
+    return -1;
+  return _stateChannelHandler(info);
+}
+
+void AsyncWebSocket::connectionProfile(AwsConnectionProfile profile){
+#ifdef ESP32
+  //power save holds frames for the next DTIM beacon, adding up to ~100ms per hop;
+  //only REALTIME changes it, and leaving REALTIME puts the application's mode back
+  wifi_ps_type_t ps;
+  if(profile == WS_PROFILE_REALTIME && _savedPowerSave < 0 && esp_wifi_get_ps(&ps) == ESP_OK){
+    _savedPowerSave = ps;
+    esp_wifi_set_ps(WIFI_PS_NONE);
+  } else if(profile != WS_PROFILE_REALTIME && _savedPowerSave >= 0){
+    esp_wifi_set_ps((wifi_ps_type_t)_savedPowerSave);
+    _savedPowerSave = -1;
+  }
+#endif
+  _profile = profile;
+}
+
 void AsyncWebSocket::_addClient(AsyncWebSocketClient * client){
   _clients.add(client);
+  //runs in the async_tcp task like every other change to _clients,
+  //so nothing has to poll for clients over the limit
+  cleanupClients(_maxClients);
 }
 
 void AsyncWebSocket::_handleDisconnect(AsyncWebSocketClient * client){
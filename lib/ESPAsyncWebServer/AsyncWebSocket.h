@@ -46,6 +46,28 @@
 #define DEFAULT_MAX_WS_CLIENTS 4
 #endif
 
+//number of latest-value channels a state channel handler may return
+#define WS_STATE_CHANNELS 4
+
+//preallocated per-client message slots for short text/binary messages
+#ifndef WS_MESSAGE_SLOTS
+#define WS_MESSAGE_SLOTS 4
+#endif
+#ifndef WS_SLOT_PAYLOAD
+#define WS_SLOT_PAYLOAD 128
+#endif
+#define WS_SLOT_HEADROOM 4 //room for an unmasked header of up to 65535 bytes
+
+//realtime connection profile: give up on a peer quickly and keep little queued for it
+#define WS_REALTIME_ACK_TIMEOUT 1000 //ms without an ACK for sent data
+#define WS_REALTIME_RX_TIMEOUT 2 //s without anything received, ACKs included
+#define WS_REALTIME_QUEUED_MESSAGES 4
+
+//largest message onMessage reassembles when it spans segments or frames
+#ifndef WS_MAX_ASSEMBLED_MESSAGE
+#define WS_MAX_ASSEMBLED_MESSAGE 512
+#endif
+
 class AsyncWebSocket;
 class AsyncWebSocketResponse;
 class AsyncWebSocketClient;
@@ -79,6 +101,17 @@ typedef enum { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING } AwsClientStatus
 typedef enum { WS_CONTINUATION, WS_TEXT, WS_BINARY, WS_DISCONNECT = 0x08, WS_PING, WS_PONG } AwsFrameType;
 typedef enum { WS_MSG_SENDING, WS_MSG_SENT, WS_MSG_ERROR } AwsMessageStatus;
 typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+typedef enum { WS_PROFILE_DEFAULT, WS_PROFILE_REALTIME } AwsConnectionProfile;
+
+//sampled from ACKs that cover message data; AsyncTCP folds ACKs that arrive
+//before the async_tcp task runs into one event, so one sample can stand for several
+typedef struct {
+    uint32_t last;     //ms from sending the oldest unacked data frame to its ACK
+    uint32_t min;
+    uint32_t max;
+    uint32_t smoothed; //ms, moving average with a 1/8 weight like TCP's SRTT
+    uint32_t samples;
+} AwsRttStats;
 
 class AsyncWebSocketMessageBuffer {
   private:
@@ -120,6 +153,8 @@ class AsyncWebSocketMessage {
     virtual size_t send(AsyncClient *client __attribute__((unused))){ return 0; }
     virtual bool finished(){ return _status != WS_MSG_SENDING; }
     virtual bool betweenFrames() const { return false; }
+    //called instead of delete once the client is done with the message
+    virtual void release(){ delete this; }
 };
 
 class AsyncWebSocketBasicMessage: public AsyncWebSocketMessage {
@@ -154,6 +189,26 @@ public:
     virtual size_t send(AsyncClient *client) override ;
 };
 
+//Message living in a client's slot array: the payload is copied behind a
+//gap that takes the frame header, so a whole frame goes out in one add()
+class AsyncWebSocketSlotMessage: public AsyncWebSocketMessage {
+  private:
+    size_t _len;
+    size_t _sent;
+    size_t _ack;
+    size_t _acked;
+    bool _inUse;
+    uint8_t _frame[WS_SLOT_HEADROOM + WS_SLOT_PAYLOAD];
+public:
+    AsyncWebSocketSlotMessage():_len(0),_sent(0),_ack(0),_acked(0),_inUse(false){}
+    bool inUse() const { return _inUse; }
+    void assign(const char * data, size_t len, uint8_t opcode=WS_TEXT, bool mask=false);
+    virtual void release() override { _inUse = false; }
+    virtual bool betweenFrames() const override { return _acked == _ack; }
+    virtual void ack(size_t len, uint32_t time) override ;
+    virtual size_t send(AsyncClient *client) override ;
+};
+
 class AsyncWebSocketClient {
   private:
     AsyncClient *_client;
@@ -162,17 +217,32 @@ class AsyncWebSocketClient {
     AwsClientStatus _status;
 
     LinkedList<AsyncWebSocketControl *> _controlQueue;
-    LinkedList<AsyncWebSocketMessage *> _messageQueue;
+    AsyncWebSocketMessage * _messageQueue[WS_MAX_QUEUED_MESSAGES];
+    uint8_t _messageHead;
+    uint8_t _messageCount;
+    AsyncWebSocketSlotMessage _slots[WS_MESSAGE_SLOTS];
 
     uint8_t _pstate;
     AwsFrameInfo _pinfo;
 
+    uint8_t *_assembly;
+    size_t _assemblyLen;
+    bool _assemblyOverflow;
+
     uint32_t _lastMessageTime;
     uint32_t _keepAlivePeriod;
+    uint8_t _maxQueued;
+    AwsRttStats _rtt;
+    uint32_t _rttSentAt; //millis() when the data frame in flight was sent
 
     void _queueMessage(AsyncWebSocketMessage *dataMessage);
+    void _queueData(const char * data, size_t len, uint8_t opcode);
+    AsyncWebSocketMessage * _frontMessage(){ return _messageCount ? _messageQueue[_messageHead] : NULL; }
+    void _popMessage();
     void _queueControl(AsyncWebSocketControl *controlMessage);
     void _runQueue();
+    void _scanStateChannels(const uint8_t *data, size_t plen, int16_t *latest);
+    void _assemble(const uint8_t *data, size_t len);
 
   public:
     void *_tempObject;
@@ -186,6 +256,7 @@ class AsyncWebSocketClient {
     AsyncClient* client(){ return _client; }
     AsyncWebSocket *server(){ return _server; }
     AwsFrameInfo const &pinfo() const { return _pinfo; }
+    AwsRttStats const &rtt() const { return _rtt; }
 
     IPAddress remoteIP();
     uint16_t  remotePort();
@@ -226,7 +297,8 @@ class AsyncWebSocketClient {
     void binary(const __FlashStringHelper *data, size_t len);
     void binary(AsyncWebSocketMessageBuffer *buffer); 
 
-    bool canSend() { return _messageQueue.length() < WS_MAX_QUEUED_MESSAGES; }
+    bool canSend() { return _messageCount < _maxQueued; }
+    size_t queuedMessages() { return _messageCount; }
 
     //system callbacks (do not call)
     void _onAck(size_t len, uint32_t time);
@@ -238,6 +310,10 @@ class AsyncWebSocketClient {
 };
 
 typedef std::function<void(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len)> AwsEventHandler;
+//complete text/binary message: points into the received segment when the message came in one piece
+typedef std::function<void(AsyncWebSocket * server, AsyncWebSocketClient * client, uint8_t opcode, const uint8_t *data, size_t len)> AwsMessageHandler;
+//returns the state channel (0..WS_STATE_CHANNELS-1) of a complete message from its header, or -1 to always deliver it
+typedef std::function<int(const AwsFrameInfo &info)> AwsStateChannelHandler;
 
 //WebServer Handler implementation that plays the role of a socket server
 class AsyncWebSocket: public AsyncWebHandler {
@@ -247,7 +323,13 @@ class AsyncWebSocket: public AsyncWebHandler {
     String _url;
     AsyncWebSocketClientLinkedList _clients;
     uint32_t _cNextId;
+    uint16_t _maxClients;
+    AwsConnectionProfile _profile;
+    int _savedPowerSave; //wifi_ps_type_t in force before WS_PROFILE_REALTIME, -1 when untouched
     AwsEventHandler _eventHandler;
+    AwsMessageHandler _messageHandler;
+    AwsStateChannelHandler _stateChannelHandler;
+    uint32_t _stateSkipped;
     bool _enabled;
     AsyncWebLock _lock;
 
@@ -267,6 +349,16 @@ class AsyncWebSocket: public AsyncWebHandler {
     void close(uint32_t id, uint16_t code=0, const char * message=NULL);
     void closeAll(uint16_t code=0, const char * message=NULL);
     void cleanupClients(uint16_t maxClients = DEFAULT_MAX_WS_CLIENTS);
+    //limit enforced as clients connect, the oldest one is closed to make room;
+    //disconnected clients are removed by their own disconnect event
+    void maxClients(uint16_t maxClients){ _maxClients = maxClients; }
+    uint16_t maxClients() const { return _maxClients; }
+
+    //applied to clients as they connect; WS_PROFILE_REALTIME turns off Nagle,
+    //shortens the ACK/RX timeouts, caps the send queue and keeps the WiFi modem awake
+    //until another profile is set, which restores the previous power save mode
+    void connectionProfile(AwsConnectionProfile profile);
+    AwsConnectionProfile connectionProfile() const { return _profile; }
 
     void ping(uint32_t id, uint8_t *data=NULL, size_t len=0);
     void pingAll(uint8_t *data=NULL, size_t len=0); //  done
@@ -316,11 +408,29 @@ class AsyncWebSocket: public AsyncWebHandler {
       _eventHandler = handler;
     }
 
+    //whole messages as a length-delimited view, no NUL terminator; the data is only
+    //valid during the call and must not be written to
+    void onMessage(AwsMessageHandler handler){
+      _messageHandler = handler;
+    }
+    bool hasMessageHandler() const { return (bool)_messageHandler; }
+
+    //state channels: of the messages that arrive together in one TCP segment, only the
+    //newest per channel reaches onEvent, older ones are skipped without being unmasked
+    void stateChannels(AwsStateChannelHandler handler){
+      _stateChannelHandler = handler;
+    }
+    bool hasStateChannels() const { return (bool)_stateChannelHandler; }
+    uint32_t stateSkipped() const { return _stateSkipped; }
+
     //system callbacks (do not call)
     uint32_t _getNextId(){ return _cNextId++; }
     void _addClient(AsyncWebSocketClient * client);
     void _handleDisconnect(AsyncWebSocketClient * client);
     void _handleEvent(AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len);
+    void _handleMessage(AsyncWebSocketClient * client, uint8_t opcode, const uint8_t *data, size_t len);
+    int _stateChannel(const AwsFrameInfo &info);
+    void _stateSkip(){ _stateSkipped++; }
     virtual bool canHandle(AsyncWebServerRequest *request) override final;
     virtual void handleRequest(AsyncWebServerRequest *request) override final;
 
@@ -550,33 +550,42 @@ namespace bfs
         fifo_bytes_ = static_cast<int16_t>(data_buf_[0] & 0x0F) << 8 | data_buf_[1];
         /* Number of data frames available */
         fifo_num_frames_ = fifo_bytes_ / FIFO_FRAME_SIZE_;
-        /* Read and store each frame */
+        /* Read the frames in bursts, as many as the bus buffer holds at once */
         int8_t frames_to_read = std::min(fifo_num_frames_, FIFO_MAX_NUM_FRAMES_);
-        for (int8_t i = 0; i < frames_to_read; i++)
+        for (int8_t first = 0; first < frames_to_read; first += FIFO_BURST_FRAMES_)
         {
-            if (!ReadRegisters(FIFO_READ_, FIFO_FRAME_SIZE_, data_buf_))
+            int8_t burst = std::min(static_cast<int8_t>(frames_to_read - first), FIFO_BURST_FRAMES_);
+            if (!ReadRegisters(FIFO_READ_, burst * FIFO_FRAME_SIZE_, fifo_buf_))
             {
                 return -1;
             }
-            /* Unpack the buffer */
-            accel_cnts_[0] = static_cast<int16_t>(data_buf_[0]) << 8 | data_buf_[1];
-            accel_cnts_[1] = static_cast<int16_t>(data_buf_[2]) << 8 | data_buf_[3];
-            accel_cnts_[2] = static_cast<int16_t>(data_buf_[4]) << 8 | data_buf_[5];
-            gyro_cnts_[0] = static_cast<int16_t>(data_buf_[6]) << 8 | data_buf_[7];
-            gyro_cnts_[1] = static_cast<int16_t>(data_buf_[8]) << 8 | data_buf_[9];
-            gyro_cnts_[2] = static_cast<int16_t>(data_buf_[10]) << 8 | data_buf_[11];
-            /* Convert to float values and rotate the accel / gyro axis */
-            fifo_ax_[i] = convacc(static_cast<float>(accel_cnts_[1]) * accel_scale_,
-                                  LinAccUnit::G, LinAccUnit::MPS2);
-            fifo_ay_[i] = convacc(static_cast<float>(accel_cnts_[0]) * accel_scale_,
-                                  LinAccUnit::G, LinAccUnit::MPS2);
-            fifo_az_[i] = convacc(static_cast<float>(accel_cnts_[2]) * accel_scale_ *
-                                      -1.0f,
-                                  LinAccUnit::G, LinAccUnit::MPS2);
-            fifo_gx_[i] = deg2rad(static_cast<float>(gyro_cnts_[1]) * gyro_scale_);
-            fifo_gy_[i] = deg2rad(static_cast<float>(gyro_cnts_[0]) * gyro_scale_);
-            fifo_gz_[i] = deg2rad(static_cast<float>(gyro_cnts_[2]) * gyro_scale_ *
-                                  -1.0f);
+            for (int8_t j = 0; j < burst; j++)
+            {
+                int8_t i = first + j;
+                const uint8_t *frame = fifo_buf_ + j * FIFO_FRAME_SIZE_;
+                /* Unpack the buffer */
+                accel_cnts_[0] = static_cast<int16_t>(frame[0]) << 8 | frame[1];
+                accel_cnts_[1] = static_cast<int16_t>(frame[2]) << 8 | frame[3];
+                accel_cnts_[2] = static_cast<int16_t>(frame[4]) << 8 | frame[5];
+                gyro_cnts_[0] = static_cast<int16_t>(frame[6]) << 8 | frame[7];
+                gyro_cnts_[1] = static_cast<int16_t>(frame[8]) << 8 | frame[9];
+                gyro_cnts_[2] = static_cast<int16_t>(frame[10]) << 8 | frame[11];
+                fifo_ax_cnts_[i] = accel_cnts_[1];
+                fifo_ay_cnts_[i] = accel_cnts_[0];
+                fifo_az_cnts_[i] = accel_cnts_[2];
+                /* Convert to float values and rotate the accel / gyro axis */
+                fifo_ax_[i] = convacc(static_cast<float>(accel_cnts_[1]) * accel_scale_,
+                                      LinAccUnit::G, LinAccUnit::MPS2);
+                fifo_ay_[i] = convacc(static_cast<float>(accel_cnts_[0]) * accel_scale_,
+                                      LinAccUnit::G, LinAccUnit::MPS2);
+                fifo_az_[i] = convacc(static_cast<float>(accel_cnts_[2]) * accel_scale_ *
+                                          -1.0f,
+                                      LinAccUnit::G, LinAccUnit::MPS2);
+                fifo_gx_[i] = deg2rad(static_cast<float>(gyro_cnts_[1]) * gyro_scale_);
+                fifo_gy_[i] = deg2rad(static_cast<float>(gyro_cnts_[0]) * gyro_scale_);
+                fifo_gz_[i] = deg2rad(static_cast<float>(gyro_cnts_[2]) * gyro_scale_ *
+                                      -1.0f);
+            }
         }
         return fifo_num_frames_;
     }
@@ -640,6 +649,36 @@ namespace bfs
         memcpy(data, fifo_gz_, cpy_len * sizeof(float));
         return cpy_len;
     }
+    int8_t Mpu9250::fifo_accel_x_cnts(int16_t *data, const std::size_t len)
+    {
+        if (!data)
+        {
+            return -1;
+        }
+        int8_t cpy_len = std::min(fifo_num_frames_, static_cast<int8_t>(len));
+        memcpy(data, fifo_ax_cnts_, cpy_len * sizeof(int16_t));
+        return cpy_len;
+    }
+    int8_t Mpu9250::fifo_accel_y_cnts(int16_t *data, const std::size_t len)
+    {
+        if (!data)
+        {
+            return -1;
+        }
+        int8_t cpy_len = std::min(fifo_num_frames_, static_cast<int8_t>(len));
+        memcpy(data, fifo_ay_cnts_, cpy_len * sizeof(int16_t));
+        return cpy_len;
+    }
+    int8_t Mpu9250::fifo_accel_z_cnts(int16_t *data, const std::size_t len)
+    {
+        if (!data)
+        {
+            return -1;
+        }
+        int8_t cpy_len = std::min(fifo_num_frames_, static_cast<int8_t>(len));
+        memcpy(data, fifo_az_cnts_, cpy_len * sizeof(int16_t));
+        return cpy_len;
+    }
 #endif
     bool Mpu9250::WriteRegister(uint8_t reg, uint8_t data)
     {
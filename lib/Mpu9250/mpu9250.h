@@ -128,6 +128,10 @@ namespace bfs
         int8_t fifo_gyro_x_radps(float *data, const std::size_t len);
         int8_t fifo_gyro_y_radps(float *data, const std::size_t len);
         int8_t fifo_gyro_z_radps(float *data, const std::size_t len);
+        /* Raw accel counts, axis rotated like the mps2 values but not sign flipped */
+        int8_t fifo_accel_x_cnts(int16_t *data, const std::size_t len);
+        int8_t fifo_accel_y_cnts(int16_t *data, const std::size_t len);
+        int8_t fifo_accel_z_cnts(int16_t *data, const std::size_t len);
         static constexpr int8_t FIFO_MAX_SIZE() { return FIFO_MAX_NUM_FRAMES_; }
         inline bool fifo_overflow() const { return fifo_overflow_; }
 #endif
@@ -182,12 +186,18 @@ namespace bfs
         int16_t fifo_bytes_;
         static constexpr int8_t FIFO_FRAME_SIZE_ = 12;
         static constexpr int8_t FIFO_MAX_NUM_FRAMES_ = 42;
+        /* Frames per read, 120 bytes fits the 128 byte Wire buffer */
+        static constexpr int8_t FIFO_BURST_FRAMES_ = 10;
+        uint8_t fifo_buf_[FIFO_BURST_FRAMES_ * FIFO_FRAME_SIZE_];
         float fifo_ax_[FIFO_MAX_NUM_FRAMES_];
         float fifo_ay_[FIFO_MAX_NUM_FRAMES_];
         float fifo_az_[FIFO_MAX_NUM_FRAMES_];
         float fifo_gx_[FIFO_MAX_NUM_FRAMES_];
         float fifo_gy_[FIFO_MAX_NUM_FRAMES_];
         float fifo_gz_[FIFO_MAX_NUM_FRAMES_];
+        int16_t fifo_ax_cnts_[FIFO_MAX_NUM_FRAMES_];
+        int16_t fifo_ay_cnts_[FIFO_MAX_NUM_FRAMES_];
+        int16_t fifo_az_cnts_[FIFO_MAX_NUM_FRAMES_];
 #endif
         /* Registers */
         static constexpr uint8_t PWR_MGMNT_1_ = 0x6B;
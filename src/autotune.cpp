@@ -0,0 +1,117 @@
+#include "autotune.h"
+#include "fastmath.h"
+
+namespace Autotune
+{
+    // The first oscillation is still a transient and is not measured
+    static const uint8_t WARMUP_CYCLES = 1;
+
+    void start(AutotuneType &tuner, float setpoint, float relayAmplitude, float hysteresis, uint8_t cycles, float timeout)
+    {
+        tuner.state = AUTOTUNE_RUNNING;
+        tuner.setpoint = setpoint;
+        tuner.relayAmplitude = relayAmplitude;
+        tuner.hysteresis = hysteresis;
+        tuner.timeout = timeout;
+        tuner.cyclesRequired = cycles;
+
+        tuner.relayHigh = true;
+        tuner.time = 0.0f;
+        tuner.lastRiseTime = -1.0f;
+        tuner.cycles = 0;
+        tuner.periodSum = 0.0f;
+        tuner.correlationSum = 0.0f;
+
+        tuner.ultimateGain = tuner.ultimatePeriod = 0.0f;
+        tuner.kp = tuner.ki = tuner.kd = 0.0f;
+        tuner.output = relayAmplitude;
+    }
+
+    // Ziegler-Nichols "some overshoot" rule, in parallel form
+    static void computeGains(AutotuneType &tuner)
+    {
+        tuner.ultimatePeriod = tuner.periodSum / (tuner.cycles - WARMUP_CYCLES);
+
+        // The relay's fundamental is (4 d / pi) sin(wt), and the input's
+        // component in phase with it is (2 / P) * integral(input * sin(wt)).
+        // Correlating with the square wave itself gives the same up to the
+        // input's odd harmonics, which the plant has already filtered. That
+        // makes Re G(jw) = 2 pi^2 * correlation / (16 d^2 P), and
+        // Ku = -1 / Re G. The peak amplitude of a near-triangular limit cycle
+        // would overstate the fundamental and underestimate Ku by up to 20%.
+        float d = tuner.relayAmplitude;
+        float correlation = tuner.correlationSum < 0.0f ? -tuner.correlationSum : 1e-6f;
+        tuner.ultimateGain = 8.0f * d * d * tuner.periodSum / (FastMath::PI_F * FastMath::PI_F * correlation);
+
+        tuner.kp = tuner.ultimateGain / 3.0f;
+        tuner.ki = tuner.kp / (0.5f * tuner.ultimatePeriod);
+        tuner.kd = tuner.kp * tuner.ultimatePeriod / 3.0f;
+    }
+
+    // Constant time, called once per control cycle in place of the regulator.
+    float update(AutotuneType &tuner, float input, float dt)
+    {
+        if (tuner.state != AUTOTUNE_RUNNING)
+        {
+            return 0.0f;
+        }
+
+        tuner.time += dt;
+
+        if (tuner.time > tuner.timeout)
+        {
+            cancel(tuner);
+            tuner.state = AUTOTUNE_FAILED;
+            return 0.0f;
+        }
+
+        float error = tuner.setpoint - input;
+
+        if (tuner.relayHigh && error < -tuner.hysteresis)
+        {
+            tuner.relayHigh = false;
+        }
+        else if (!tuner.relayHigh && error > tuner.hysteresis)
+        {
+            tuner.relayHigh = true;
+
+            // One full cycle ends on every rising switch
+            if (tuner.lastRiseTime >= 0.0f)
+            {
+                if (tuner.cycles >= WARMUP_CYCLES)
+                {
+                    tuner.periodSum += tuner.time - tuner.lastRiseTime;
+                }
+
+                tuner.cycles++;
+            }
+
+            tuner.lastRiseTime = tuner.time;
+
+            if (tuner.cycles >= tuner.cyclesRequired + WARMUP_CYCLES)
+            {
+                computeGains(tuner);
+                tuner.state = AUTOTUNE_DONE;
+                tuner.output = 0.0f;
+                return tuner.output;
+            }
+        }
+
+        tuner.output = tuner.relayHigh ? tuner.relayAmplitude : -tuner.relayAmplitude;
+
+        // Measured cycles run from one rising switch to another, the same
+        // span periodSum covers
+        if (tuner.cycles >= WARMUP_CYCLES)
+        {
+            tuner.correlationSum += (input - tuner.setpoint) * tuner.output * dt;
+        }
+
+        return tuner.output;
+    }
+
+    void cancel(AutotuneType &tuner)
+    {
+        tuner.state = AUTOTUNE_IDLE;
+        tuner.output = 0.0f;
+    }
+}
@@ -0,0 +1,66 @@
+#include <math.h>
+#include "filter.h"
+#include "fastmath.h"
+
+namespace Filter
+{
+    static const float BUTTERWORTH_Q = 0.70710678f;
+
+    void initLowPass(BiquadType &filter, float sampleRate, float cutoff)
+    {
+        float omega = 2.0f * FastMath::PI_F * cutoff / sampleRate;
+        float sn = sinf(omega);
+        float cs = cosf(omega);
+        float alpha = sn / (2.0f * BUTTERWORTH_Q);
+        float a0 = 1.0f + alpha;
+
+        filter.b0 = (1.0f - cs) * 0.5f / a0;
+        filter.b1 = (1.0f - cs) / a0;
+        filter.b2 = filter.b0;
+        filter.a1 = -2.0f * cs / a0;
+        filter.a2 = (1.0f - alpha) / a0;
+
+        reset(filter, 0.0f);
+    }
+
+    void initNotch(BiquadType &filter, float sampleRate, float centre, float q)
+    {
+        setNotch(filter, sampleRate, centre, q);
+        reset(filter, 0.0f);
+    }
+
+    // Moves the notch without touching the state, so it can track a
+    // changing frequency every sample without a transient.
+    void setNotch(BiquadType &filter, float sampleRate, float centre, float q)
+    {
+        float omega = 2.0f * FastMath::PI_F * centre / sampleRate;
+        float sn = sinf(omega);
+        float cs = cosf(omega);
+        float alpha = sn / (2.0f * q);
+        float a0 = 1.0f + alpha;
+
+        filter.b0 = 1.0f / a0;
+        filter.b1 = -2.0f * cs / a0;
+        filter.b2 = filter.b0;
+        filter.a1 = filter.b1;
+        filter.a2 = (1.0f - alpha) / a0;
+    }
+
+    // Preload the state as if the input had been `value` forever.
+    void reset(BiquadType &filter, float value)
+    {
+        float gain = (filter.b0 + filter.b1 + filter.b2) / (1.0f + filter.a1 + filter.a2);
+        float output = value * gain;
+
+        filter.s1 = output - filter.b0 * value;
+        filter.s2 = filter.b2 * value - filter.a2 * output;
+    }
+
+    float apply(BiquadType &filter, float input)
+    {
+        float output = filter.b0 * input + filter.s1;
+        filter.s1 = filter.b1 * input - filter.a1 * output + filter.s2;
+        filter.s2 = filter.b2 * input - filter.a2 * output;
+        return output;
+    }
+}
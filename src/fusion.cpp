@@ -0,0 +1,60 @@
+#include "fusion.h"
+#include "fastmath.h"
+
+namespace Fusion
+{
+    static const float GRAVITY = 9.80665f;
+    static const float ACC_TRUST_SMOOTHING = 0.05f;     // EMA factor for norm mean / variance
+    static const float ACC_TRUST_NORM_BAND = 0.15f;     // g, |norm - 1g| at which trust drops to 0
+    static const float ACC_TRUST_VARIANCE_BAND = 0.01f; // g^2, norm variance at which trust drops to 0
+
+    void init(FusionType &fusion, FusionModeType mode, float accPart)
+    {
+        fusion.accPart = accPart;
+        fusion.angles = {0.0f, 0.0f, 0.0f};
+        setMode(fusion, mode);
+    }
+
+    void setMode(FusionType &fusion, FusionModeType mode)
+    {
+        fusion.mode = mode;
+        fusion.trust = {1.0f, 0.0f, 1.0f};
+    }
+
+    // Weight for the accel correction: 1 when the measured vector is a steady
+    // 1 g, falling linearly to 0 as the norm leaves 1 g or starts to vibrate.
+    float updateAccelTrust(AccelTrustType &state, float accelNorm)
+    {
+        float deviation = accelNorm - state.normMean;
+        state.normMean += ACC_TRUST_SMOOTHING * deviation;
+        state.normVariance = (1.0f - ACC_TRUST_SMOOTHING) * (state.normVariance + ACC_TRUST_SMOOTHING * deviation * deviation);
+
+        float normError = accelNorm > 1.0f ? accelNorm - 1.0f : 1.0f - accelNorm;
+        float trust = 1.0f - normError / ACC_TRUST_NORM_BAND - state.normVariance / ACC_TRUST_VARIANCE_BAND;
+
+        state.trust = trust < 0.0f ? 0.0f : (trust > 1.0f ? 1.0f : trust);
+        return state.trust;
+    }
+
+    // accel in m/s^2, gyro in rad/s, dt in s
+    void update(FusionType &fusion, const AxisType &accel, const AxisType &gyro, float dt)
+    {
+        AxisType accelAngles = {0.0f, 0.0f, 0.0f};
+
+        accelAngles.x = FastMath::atan2(-1 * accel.y, accel.z);
+        accelAngles.y = FastMath::atan2(-1 * accel.x, FastMath::sqrt(accel.y * accel.y + accel.z * accel.z));
+
+        float accPart = fusion.accPart;
+
+        if (fusion.mode == FUSION_ADAPTIVE)
+        {
+            float accelNorm = FastMath::sqrt(accel.x * accel.x + accel.y * accel.y + accel.z * accel.z) / GRAVITY;
+            accPart *= updateAccelTrust(fusion.trust, accelNorm);
+        }
+
+        float gyroPart = 1.0f - accPart;
+
+        fusion.angles.x = gyroPart * (fusion.angles.x + (gyro.x * dt)) + (accPart * accelAngles.x);
+        fusion.angles.y = gyroPart * (fusion.angles.y + (gyro.y * dt)) + (accPart * accelAngles.y);
+    }
+}
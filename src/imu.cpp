@@ -2,22 +2,63 @@
 #include <stdio.h>
 #include "imu.h"
 #include "log.h"
+#include "fastmath.h"
 
 namespace Imu
 {
     static float GYRO_PART = 0.998;
-    static float ACC_PART = 1.0 - GYRO_PART;
+    static float ACC_PART = 1.0f - GYRO_PART;
+
+    static const float GRAVITY = 9.80665f;
+
+    // The sensor runs at 1 kHz into its FIFO; every frame goes through the
+    // anti-alias low-pass below and the control loop only sees the newest
+    // filtered frame, however many arrived since it last looked.
+    static const uint8_t SENSOR_SRD = 0;
+    static const float SENSOR_RATE = 1000.0f; // Hz, 1 kHz / (1 + SENSOR_SRD)
+    static const float GYRO_LPF_CUTOFF = 100.0f; // Hz
+    static const float ACCEL_LPF_CUTOFF = 50.0f; // Hz
+    static const int8_t FIFO_SIZE = bfs::Mpu9250::FIFO_MAX_SIZE();
+    static const TimestampType SENSOR_PERIOD = (TimestampType)(1000000.0f / SENSOR_RATE); // us
+    static const TimestampType CLOCK_CORRECTION = 16; // fraction of the sensor clock error taken out per read
+
+    static const float ACCEL_COUNTS_TO_G = 16.0f / 32768.0f; // ACCEL_RANGE_16G
+    static const int32_t ACCEL_CLIP_COUNTS = 32767;
+    static const float VIBRATION_SMOOTHING = 0.01f; // per 1 kHz sample, ~100 ms window
+    static const uint32_t VIBRATION_WINDOW = 1000;   // samples, 1 s blocks for peaks and clip counts
+
+    // Notches on the gyro at every motor's rotation frequency and harmonics,
+    // moved each cycle from the ESC RPM telemetry
+    static const float RPM_NOTCH_Q = 5.0f;
+    static const float RPM_NOTCH_MIN_FREQUENCY = 80.0f;                   // Hz, below this the notch is off
+    static const float RPM_NOTCH_MAX_FREQUENCY = 0.45f * SENSOR_RATE;     // Hz, keep clear of Nyquist
+
+    FusionType fusion = {FUSION_ADAPTIVE, ACC_PART, {1.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}};
 
     bfs::Mpu9250 sensor(&Wire, 0x68);
 
     bool dataAvailable = false;
-    float lastReadMicros;
+    TimestampType lastSampleTimestamp = 0;
+    TimestampType anglesTimestamp = 0;
 
     MeridialFilterType accelFilterData;
+    AxisFilterType accelLowPass;
+    AxisFilterType gyroLowPass;
+    AxisFilterType rpmNotch[RPM_FILTER_MOTORS][RPM_FILTER_HARMONICS];
+    bool rpmNotchActive[RPM_FILTER_MOTORS][RPM_FILTER_HARMONICS] = {{false}};
+
+    float fifoAccelX[FIFO_SIZE], fifoAccelY[FIFO_SIZE], fifoAccelZ[FIFO_SIZE];
+    float fifoGyroX[FIFO_SIZE], fifoGyroY[FIFO_SIZE], fifoGyroZ[FIFO_SIZE];
+    int16_t fifoAccelCountsX[FIFO_SIZE], fifoAccelCountsY[FIFO_SIZE], fifoAccelCountsZ[FIFO_SIZE];
+    uint32_t fifoOverflows = 0;
+    TimestampType newestFrameTimestamp = 0; // sensor clock, 0 until the first read
+
+    VibrationType vibration;
+    uint32_t vibrationSamples = 0; // in the current window
 
     AxisType gyroAngles = {0.0, 0.0, 0.0};
-    AxisType radAngles = {0.0, 0.0, 0.0};
     AxisType degAngles = {0.0, 0.0, 0.0};
+    AxisType degRates = {0.0, 0.0, 0.0};
 
     ImuType rawData = {
         {0.0, 0.0, 0.0},
@@ -53,10 +94,28 @@ namespace Imu
             Log::error("Error ConfibfsgGyroRange");
         }
 
-        // if (!sensor.ConfigSrd(19))
-        // {
-        //     Log::error("Error configured SRD");
-        // }
+        if (!sensor.ConfigDlpfBandwidth(bfs::Mpu9250::DLPF_BANDWIDTH_184HZ))
+        {
+            Log::error("Error ConfigDlpfBandwidth");
+        }
+
+        if (!sensor.ConfigSrd(SENSOR_SRD))
+        {
+            Log::error("Error configured SRD");
+        }
+
+        if (!sensor.EnableFifo())
+        {
+            Log::error("Error EnableFifo");
+        }
+
+        Filter::initLowPass(accelLowPass.x, SENSOR_RATE, ACCEL_LPF_CUTOFF);
+        Filter::initLowPass(accelLowPass.y, SENSOR_RATE, ACCEL_LPF_CUTOFF);
+        Filter::initLowPass(accelLowPass.z, SENSOR_RATE, ACCEL_LPF_CUTOFF);
+
+        Filter::initLowPass(gyroLowPass.x, SENSOR_RATE, GYRO_LPF_CUTOFF);
+        Filter::initLowPass(gyroLowPass.y, SENSOR_RATE, GYRO_LPF_CUTOFF);
+        Filter::initLowPass(gyroLowPass.z, SENSOR_RATE, GYRO_LPF_CUTOFF);
 
         // if (!sensor.EnableDrdyInt())
         // {
@@ -66,8 +125,6 @@ namespace Imu
         // pinMode(19, INPUT);
         // attachInterrupt(19, recordRawData, RISING);
 
-        lastReadMicros = micros();
-
         byte mSize = 11;
 
         accelFilterData.x = median_filter_new(mSize, 0.0);
@@ -110,34 +167,156 @@ namespace Imu
         dataOffset.gyro.y = gyroSum.y / times;
         dataOffset.gyro.z = gyroSum.z / times;
 
+        lastSampleTimestamp = 0;
+        resetVibration();
+
         delay(1000);
     }
 
+    void updateVibration(VibrationAxisType &axis, int16_t counts)
+    {
+        if (counts >= ACCEL_CLIP_COUNTS || counts <= -ACCEL_CLIP_COUNTS)
+        {
+            axis.clipCount++;
+        }
+
+        float sample = counts * ACCEL_COUNTS_TO_G;
+        float deviation = sample - axis.mean;
+
+        axis.mean += VIBRATION_SMOOTHING * deviation;
+        axis.meanSquare += VIBRATION_SMOOTHING * (deviation * deviation - axis.meanSquare);
+
+        float magnitude = fabsf(deviation);
+        if (magnitude > axis.peak)
+        {
+            axis.peak = magnitude;
+        }
+    }
+
+    // Peaks and clip counts are read per complete window, so every reader sees
+    // the same figures however often it asks.
+    void closeVibrationWindow(VibrationAxisType &axis)
+    {
+        axis.windowClipCount = axis.clipCount;
+        axis.windowPeak = axis.peak;
+        axis.clipCount = 0;
+        axis.peak = 0.0f;
+    }
+
+    void applyRpmNotches(float &x, float &y, float &z)
+    {
+        for (uint8_t motor = 0; motor < RPM_FILTER_MOTORS; motor++)
+        {
+            for (uint8_t harmonic = 0; harmonic < RPM_FILTER_HARMONICS; harmonic++)
+            {
+                if (!rpmNotchActive[motor][harmonic])
+                {
+                    continue;
+                }
+
+                AxisFilterType &notch = rpmNotch[motor][harmonic];
+                x = Filter::apply(notch.x, x);
+                y = Filter::apply(notch.y, y);
+                z = Filter::apply(notch.z, z);
+            }
+        }
+    }
+
+    // Frames are SENSOR_PERIOD apart on the sensor's own clock, so the newest
+    // one is the previous newest plus the frame count. That clock is locked
+    // to the read time, which only bounds the newest frame to within one
+    // period, and snaps to it when they are a period apart (start, overflow).
+    TimestampType frameTimestamp(TimestampType readTimestamp, int8_t frames)
+    {
+        // The FIFO count is read first, so every counted frame is older
+        TimestampType measured = readTimestamp - SENSOR_PERIOD / 2;
+        TimestampType expected = newestFrameTimestamp + frames * SENSOR_PERIOD;
+        TimestampType error = measured - expected;
+
+        if (newestFrameTimestamp == 0 || error > SENSOR_PERIOD || error < -SENSOR_PERIOD)
+        {
+            newestFrameTimestamp = measured;
+        }
+        else
+        {
+            newestFrameTimestamp = expected + error / CLOCK_CORRECTION;
+        }
+
+        return newestFrameTimestamp;
+    }
+
     void updateData()
     {
-        if (!sensor.Read())
+        TimestampType readTimestamp = Timing::now();
+        int8_t frames = sensor.ReadFifo();
+
+        if (frames <= 0)
+        {
+            return;
+        }
+
+        // A full FIFO has overflowed and may be misaligned, start over
+        if (frames >= FIFO_SIZE)
         {
+            fifoOverflows++;
+            sensor.DisableFifo();
+            sensor.EnableFifo();
+            newestFrameTimestamp = 0;
             return;
         }
 
-        // Raw data
-        rawData.accel.x = sensor.accel_x_mps2();
-        rawData.accel.y = sensor.accel_y_mps2();
-        rawData.accel.z = sensor.accel_z_mps2();
+        // Frame i of the batch is (frames - 1 - i) periods older than this
+        rawData.timestamp = frameTimestamp(readTimestamp, frames);
+
+        sensor.fifo_accel_x_mps2(fifoAccelX, FIFO_SIZE);
+        sensor.fifo_accel_y_mps2(fifoAccelY, FIFO_SIZE);
+        sensor.fifo_accel_z_mps2(fifoAccelZ, FIFO_SIZE);
 
-        rawData.gyro.x = sensor.gyro_x_radps();
-        rawData.gyro.y = sensor.gyro_y_radps();
-        rawData.gyro.z = sensor.gyro_z_radps();
+        sensor.fifo_gyro_x_radps(fifoGyroX, FIFO_SIZE);
+        sensor.fifo_gyro_y_radps(fifoGyroY, FIFO_SIZE);
+        sensor.fifo_gyro_z_radps(fifoGyroZ, FIFO_SIZE);
+
+        sensor.fifo_accel_x_cnts(fifoAccelCountsX, FIFO_SIZE);
+        sensor.fifo_accel_y_cnts(fifoAccelCountsY, FIFO_SIZE);
+        sensor.fifo_accel_z_cnts(fifoAccelCountsZ, FIFO_SIZE);
+
+        // Raw data, decimated down to the newest anti-aliased frame
+        for (int8_t i = 0; i < frames; i++)
+        {
+            updateVibration(vibration.x, fifoAccelCountsX[i]);
+            updateVibration(vibration.y, fifoAccelCountsY[i]);
+            updateVibration(vibration.z, fifoAccelCountsZ[i]);
+
+            if (++vibrationSamples >= VIBRATION_WINDOW)
+            {
+                closeVibrationWindow(vibration.x);
+                closeVibrationWindow(vibration.y);
+                closeVibrationWindow(vibration.z);
+                vibrationSamples = 0;
+            }
+
+            rawData.accel.x = Filter::apply(accelLowPass.x, fifoAccelX[i]);
+            rawData.accel.y = Filter::apply(accelLowPass.y, fifoAccelY[i]);
+            rawData.accel.z = Filter::apply(accelLowPass.z, fifoAccelZ[i]);
+
+            applyRpmNotches(fifoGyroX[i], fifoGyroY[i], fifoGyroZ[i]);
+
+            rawData.gyro.x = Filter::apply(gyroLowPass.x, fifoGyroX[i]);
+            rawData.gyro.y = Filter::apply(gyroLowPass.y, fifoGyroY[i]);
+            rawData.gyro.z = Filter::apply(gyroLowPass.z, fifoGyroZ[i]);
+        }
 
         // Data with offset
         data.accel.x = rawData.accel.x - dataOffset.accel.x;
         data.accel.y = rawData.accel.y - dataOffset.accel.y;
-        data.accel.z = -1 * ((rawData.accel.z - dataOffset.accel.z) - 9.80665f);
+        data.accel.z = -1 * ((rawData.accel.z - dataOffset.accel.z) - GRAVITY);
 
         data.gyro.x = rawData.gyro.x - dataOffset.gyro.x;
         data.gyro.y = rawData.gyro.y - dataOffset.gyro.y;
         data.gyro.z = rawData.gyro.z - dataOffset.gyro.z;
 
+        data.timestamp = rawData.timestamp;
+
         // Apply Median Filter on Accel data
         median_filter_in(accelFilterData.x, data.accel.x);
         median_filter_in(accelFilterData.y, data.accel.y);
@@ -161,21 +340,23 @@ namespace Imu
 
         dataAvailable = false;
 
-        AxisType accelAngles = {0.0, 0.0, 0.0};
-
-        accelAngles.x = atan2(-1 * data.accel.y, data.accel.z);
-        accelAngles.y = atan2(-1 * data.accel.x, sqrt(data.accel.y * data.accel.y + data.accel.z * data.accel.z));
+        if (lastSampleTimestamp == 0)
+        {
+            lastSampleTimestamp = data.timestamp;
+            return;
+        }
 
-        float dt = (float)(micros() - lastReadMicros) / 1000000;
+        float dt = Timing::toSeconds(data.timestamp - lastSampleTimestamp);
+        lastSampleTimestamp = data.timestamp;
 
-        radAngles.x = GYRO_PART * (radAngles.x + (data.gyro.x * dt)) + (ACC_PART * accelAngles.x);
-        radAngles.y = GYRO_PART * (radAngles.y + (data.gyro.y * dt)) + (ACC_PART * accelAngles.y);
+        Fusion::update(fusion, data.accel, data.gyro, dt);
 
         gyroAngles.x = gyroAngles.x + (data.gyro.x * dt);
         gyroAngles.y = gyroAngles.y + (data.gyro.y * dt);
         gyroAngles.z = gyroAngles.z + (data.gyro.z * dt);
 
-        degAngles = {(float)(radAngles.x * RAD_TO_DEG), (float)(radAngles.y * RAD_TO_DEG), (float)(gyroAngles.z * RAD_TO_DEG)};
+        degAngles = {fusion.angles.x * FastMath::RAD_TO_DEG_F, fusion.angles.y * FastMath::RAD_TO_DEG_F, gyroAngles.z * FastMath::RAD_TO_DEG_F};
+        degRates = {data.gyro.x * FastMath::RAD_TO_DEG_F, data.gyro.y * FastMath::RAD_TO_DEG_F, data.gyro.z * FastMath::RAD_TO_DEG_F};
 
         // Serial.print("GyroX:");
         // Serial.print(gyroAngles.x * RAD_TO_DEG);
@@ -184,9 +365,9 @@ namespace Imu
         // Serial.print(accelAngles.x * RAD_TO_DEG);
         // Serial.print(",");
         // Serial.print("CompX:");
-        // Serial.println(radAngles.x * RAD_TO_DEG);
+        // Serial.println(fusion.angles.x * RAD_TO_DEG);
 
-        lastReadMicros = micros();
+        anglesTimestamp = data.timestamp;
     }
 
     AxisType getDegAngles()
@@ -194,9 +375,90 @@ namespace Imu
         return degAngles;
     }
 
+    AxisType getDegRates()
+    {
+        return degRates;
+    }
+
+    TimestampType getTimestamp()
+    {
+        return anglesTimestamp;
+    }
+
+    void setFusionMode(FusionModeType mode)
+    {
+        Fusion::setMode(fusion, mode);
+    }
+
+    AccelTrustType getAccelTrust()
+    {
+        return fusion.trust;
+    }
+
+    uint32_t getFifoOverflows()
+    {
+        return fifoOverflows;
+    }
+
+    VibrationType getVibration()
+    {
+        VibrationType result = vibration;
+
+        result.x.rms = FastMath::sqrt(result.x.meanSquare);
+        result.y.rms = FastMath::sqrt(result.y.meanSquare);
+        result.z.rms = FastMath::sqrt(result.z.meanSquare);
+
+        return result;
+    }
+
+    // Clears the clip counters and peaks, keeps the running averages.
+    void resetVibration()
+    {
+        vibration.x.clipCount = vibration.y.clipCount = vibration.z.clipCount = 0;
+        vibration.x.peak = vibration.y.peak = vibration.z.peak = 0.0f;
+        vibration.x.windowClipCount = vibration.y.windowClipCount = vibration.z.windowClipCount = 0;
+        vibration.x.windowPeak = vibration.y.windowPeak = vibration.z.windowPeak = 0.0f;
+        vibrationSamples = 0;
+    }
+
+    // Rotation frequency of every motor in Hz, 0 when unknown. Called once
+    // per control cycle, the notches keep their state as they move.
+    void setMotorFrequencies(const float *frequencies, uint8_t count)
+    {
+        for (uint8_t motor = 0; motor < RPM_FILTER_MOTORS; motor++)
+        {
+            for (uint8_t harmonic = 0; harmonic < RPM_FILTER_HARMONICS; harmonic++)
+            {
+                float centre = motor < count ? frequencies[motor] * (harmonic + 1) : 0.0f;
+                bool active = centre >= RPM_NOTCH_MIN_FREQUENCY && centre <= RPM_NOTCH_MAX_FREQUENCY;
+                AxisFilterType &notch = rpmNotch[motor][harmonic];
+
+                if (active)
+                {
+                    // Same coefficients on every axis, only the state differs
+                    Filter::setNotch(notch.x, SENSOR_RATE, centre, RPM_NOTCH_Q);
+                    notch.y.b0 = notch.z.b0 = notch.x.b0;
+                    notch.y.b1 = notch.z.b1 = notch.x.b1;
+                    notch.y.b2 = notch.z.b2 = notch.x.b2;
+                    notch.y.a1 = notch.z.a1 = notch.x.a1;
+                    notch.y.a2 = notch.z.a2 = notch.x.a2;
+
+                    if (!rpmNotchActive[motor][harmonic])
+                    {
+                        Filter::reset(notch.x, rawData.gyro.x);
+                        Filter::reset(notch.y, rawData.gyro.y);
+                        Filter::reset(notch.z, rawData.gyro.z);
+                    }
+                }
+
+                rpmNotchActive[motor][harmonic] = active;
+            }
+        }
+    }
+
     void printAxis(AxisType axis)
     {
-        serialPrintlnf("x: %f, y:%f, z:%f", axis.x, axis.y, axis.z);
+        serialPrintlnf("x: %f, y:%f, z:%f", (double)axis.x, (double)axis.y, (double)axis.z);
     }
 
     void serialPrintf(const char *format, ...)
@@ -0,0 +1,89 @@
+#include "linkfilter.h"
+
+namespace LinkFilter
+{
+    static const uint32_t MAX_AGE = 100;          // ms, frames delayed longer than this are dropped
+    static const uint32_t CLOCK_STEP = 1000;      // ms, a newer frame stamped this much before the last one means the client clock stepped back
+    static const float QUALITY_SMOOTHING = 0.05f; // per expected frame
+    static const uint32_t QUALITY_WINDOW = 100;   // missed frames beyond this can't lower quality further
+    static const uint32_t BASELINE_WINDOW = 2000; // ms, the delay baseline is the minimum over the last one to two of these
+
+    static void updateQuality(LinkStatsType &stats, uint32_t missed)
+    {
+        for (uint32_t i = 0; i < missed && i < QUALITY_WINDOW; i++)
+        {
+            stats.quality -= QUALITY_SMOOTHING * stats.quality;
+        }
+
+        stats.quality += QUALITY_SMOOTHING * (1.0f - stats.quality);
+    }
+
+    static void rebase(LinkFilterType &filter, int32_t delay, uint32_t now)
+    {
+        filter.minDelay = filter.windowMinDelay = filter.lastWindowMinDelay = delay;
+        filter.windowStart = now;
+    }
+
+    // The first frame, or the first after a timeout, starts a new session
+    void start(LinkFilterType &filter, const ControlFrameType &frame, uint32_t now)
+    {
+        filter.lastSequence = frame.sequence - 1;
+        filter.lastClientTimestamp = frame.clientTimestamp;
+        filter.stats.quality = 1.0f;
+        rebase(filter, (int32_t)(now - frame.clientTimestamp), now);
+    }
+
+    // True when the frame is the newest so far and arrived in time.
+    bool accept(LinkFilterType &filter, const ControlFrameType &frame, uint32_t now)
+    {
+        if (!Protocol::isNewer(frame.sequence, filter.lastSequence))
+        {
+            filter.stats.outOfOrder++;
+            return false;
+        }
+
+        int32_t delay = (int32_t)(now - frame.clientTimestamp);
+
+        // Frames held up in a WiFi stall keep their order and spacing, so only
+        // a real step of the client clock makes a newer frame look much older
+        if ((int32_t)(frame.clientTimestamp - filter.lastClientTimestamp) < -(int32_t)CLOCK_STEP)
+        {
+            rebase(filter, delay, now);
+        }
+
+        filter.lastClientTimestamp = frame.clientTimestamp;
+
+        // The clocks aren't synchronised, but the fastest recent delivery
+        // gives a baseline; anything much slower than that is stale. The
+        // minimum is windowed so the baseline follows clock drift upwards too.
+        if (delay < filter.windowMinDelay)
+        {
+            filter.windowMinDelay = delay;
+        }
+
+        if (now - filter.windowStart >= BASELINE_WINDOW)
+        {
+            filter.lastWindowMinDelay = filter.windowMinDelay;
+            filter.windowMinDelay = delay;
+            filter.windowStart = now;
+        }
+
+        filter.minDelay = filter.windowMinDelay < filter.lastWindowMinDelay ? filter.windowMinDelay : filter.lastWindowMinDelay;
+
+        uint32_t missed = frame.sequence - filter.lastSequence - 1;
+        filter.stats.lost += missed;
+        filter.lastSequence = frame.sequence;
+
+        if ((uint32_t)(delay - filter.minDelay) > MAX_AGE)
+        {
+            filter.stats.stale++;
+            updateQuality(filter.stats, missed + 1);
+            return false;
+        }
+
+        updateQuality(filter.stats, missed);
+        filter.stats.received++;
+
+        return true;
+    }
+}
@@ -0,0 +1,92 @@
+#include <Arduino.h>
+#include "lut.h"
+
+namespace Lut
+{
+    void init(LutType &lut, float inputMin, float inputMax, const float *values, int count)
+    {
+        if (count > LUT_MAX_POINTS)
+        {
+            count = LUT_MAX_POINTS;
+        }
+
+        lut.inputMin = inputMin;
+        lut.inputMax = inputMax;
+        lut.count = count;
+        lut.invStep = count > 1 ? (count - 1) / (inputMax - inputMin) : 0.0f;
+
+        for (int i = 0; i < count; i++)
+        {
+            lut.values[i] = values[i];
+        }
+    }
+
+    float lookup(const LutType &lut, float input)
+    {
+        float position = (input - lut.inputMin) * lut.invStep;
+
+        if (position <= 0.0f)
+        {
+            return lut.values[0];
+        }
+
+        int index = (int)position;
+
+        if (index >= lut.count - 1)
+        {
+            return lut.values[lut.count - 1];
+        }
+
+        float fraction = position - index;
+        return lut.values[index] + fraction * (lut.values[index + 1] - lut.values[index]);
+    }
+
+    // Never waits: the caller may be a network task that must not stall
+    LutType *spare(LutBufferType &buffer)
+    {
+        int index = 1 - buffer.active;
+
+        if (buffer.readers[index] != 0)
+        {
+            return NULL;
+        }
+
+        return &buffer.tables[index];
+    }
+
+    void publish(LutBufferType &buffer)
+    {
+        __sync_synchronize(); // table contents before the flip
+        buffer.active = 1 - buffer.active;
+    }
+
+    const LutType &acquire(LutBufferType &buffer)
+    {
+        for (;;)
+        {
+            int index = buffer.active;
+            __sync_fetch_and_add(&buffer.readers[index], 1);
+
+            // Still the active one after taking it, so spare() will see us
+            if (buffer.active == index)
+            {
+                return buffer.tables[index];
+            }
+
+            __sync_fetch_and_sub(&buffer.readers[index], 1);
+        }
+    }
+
+    void release(LutBufferType &buffer, const LutType &lut)
+    {
+        __sync_fetch_and_sub(&buffer.readers[&lut - buffer.tables], 1);
+    }
+
+    float lookup(LutBufferType &buffer, float input)
+    {
+        const LutType &lut = acquire(buffer);
+        float output = lookup(lut, input);
+        release(buffer, lut);
+        return output;
+    }
+}
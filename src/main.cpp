@@ -15,6 +15,6 @@ void setup()
 
 void loop()
 {
-    Rc::process();
     Imu::process();
+    Rc::process();
 }
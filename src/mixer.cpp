@@ -0,0 +1,141 @@
+#include <Arduino.h>
+#include "mixer.h"
+#include "fastmath.h"
+
+namespace Mixer
+{
+    // Motors are numbered clockwise seen from above, starting with the first
+    // one right of the nose, and alternate in spin starting with -1 (so quad X
+    // is front right, rear right, rear left, front left).
+    void init(MixerType &mixer, FrameType frame, float outputMin, float outputMax)
+    {
+        uint8_t motorCount = 4;
+        bool plus = false;
+
+        switch (frame)
+        {
+        case FRAME_QUAD_X:
+            break;
+        case FRAME_QUAD_PLUS:
+            plus = true;
+            break;
+        case FRAME_HEXA_X:
+            motorCount = 6;
+            break;
+        case FRAME_HEXA_PLUS:
+            motorCount = 6;
+            plus = true;
+            break;
+        case FRAME_OCTO_X:
+            motorCount = 8;
+            break;
+        case FRAME_OCTO_PLUS:
+            motorCount = 8;
+            plus = true;
+            break;
+        }
+
+        float angles[MIXER_MAX_MOTORS];
+        float spins[MIXER_MAX_MOTORS];
+        float step = 360.0f / motorCount;
+
+        for (uint8_t i = 0; i < motorCount; i++)
+        {
+            angles[i] = (plus ? 0.0f : step * 0.5f) + step * i;
+            spins[i] = i % 2 == 0 ? -1.0f : 1.0f;
+        }
+
+        initGeometry(mixer, motorCount, angles, spins, outputMin, outputMax);
+    }
+
+    // angles: deg clockwise from the nose, spins: yaw contribution sign per motor
+    void initGeometry(MixerType &mixer, uint8_t motorCount, const float *angles, const float *spins, float outputMin, float outputMax)
+    {
+        mixer.matrix.setZero();
+        mixer.motorCount = min(motorCount, (uint8_t)MIXER_MAX_MOTORS);
+        mixer.outputMin = outputMin;
+        mixer.outputMax = outputMax;
+        mixer.airmode = false;
+
+        for (uint8_t i = 0; i < mixer.motorCount; i++)
+        {
+            float angle = angles[i] * FastMath::DEG_TO_RAD_F;
+
+            mixer.matrix(i, 0) = -sinf(angle);
+            mixer.matrix(i, 1) = -cosf(angle);
+            mixer.matrix(i, 2) = spins[i];
+        }
+
+        // Scale each axis so its strongest motor sees the full command
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float scale = mixer.matrix.col(axis).cwiseAbs().maxCoeff();
+
+            if (scale > 0.0f)
+            {
+                mixer.matrix.col(axis) /= scale;
+            }
+        }
+    }
+
+    void setAirmode(MixerType &mixer, bool enabled)
+    {
+        mixer.airmode = enabled;
+    }
+
+    void mix(const MixerType &mixer, float throttle, float roll, float pitch, float yaw, float *motors)
+    {
+        uint8_t count = mixer.motorCount;
+        float span = mixer.outputMax - mixer.outputMin;
+
+        MotorVectorType rollPitch = mixer.matrix.col(0) * roll + mixer.matrix.col(1) * pitch;
+        MotorVectorType yawMix = mixer.matrix.col(2) * yaw;
+
+        // Roll / pitch first: if even they do not fit, scale them down together
+        float rollPitchRange = rollPitch.head(count).maxCoeff() - rollPitch.head(count).minCoeff();
+
+        if (rollPitchRange > span)
+        {
+            rollPitch *= span / rollPitchRange;
+            rollPitchRange = span;
+            yawMix.setZero();
+        }
+
+        // Yaw gets whatever span is left
+        MotorVectorType attitude = rollPitch + yawMix;
+        float attitudeMax = attitude.head(count).maxCoeff();
+        float attitudeMin = attitude.head(count).minCoeff();
+        float attitudeRange = attitudeMax - attitudeMin;
+
+        if (attitudeRange > span)
+        {
+            attitude = rollPitch + yawMix * ((span - rollPitchRange) / (attitudeRange - rollPitchRange));
+            attitudeMax = attitude.head(count).maxCoeff();
+            attitudeMin = attitude.head(count).minCoeff();
+        }
+
+        // Then move throttle, never the attitude correction, to fit the range
+        if (throttle + attitudeMax > mixer.outputMax)
+        {
+            throttle = mixer.outputMax - attitudeMax;
+        }
+
+        if (throttle + attitudeMin < mixer.outputMin)
+        {
+            if (mixer.airmode)
+            {
+                throttle = mixer.outputMin - attitudeMin;
+            }
+            else if (attitudeMin < 0.0f)
+            {
+                // Without airmode throttle stays put and authority shrinks
+                attitude *= max(0.0f, throttle - mixer.outputMin) / -attitudeMin;
+            }
+        }
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            motors[i] = constrain(throttle + attitude(i), mixer.outputMin, mixer.outputMax);
+        }
+    }
+}
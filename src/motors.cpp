@@ -0,0 +1,128 @@
+#include "motors.h"
+#include "log.h"
+
+#if defined(MOTOR_DSHOT)
+#include <DShot.h>
+#else
+#include <ESP32Servo.h>
+#endif
+
+namespace Motors
+{
+    // front right, rear right, rear left, front left
+    const int PINS[MOTORS_COUNT] = {26, 25, 32, 33};
+
+#if defined(MOTOR_DSHOT)
+#if defined(MOTOR_DSHOT_BIDIR)
+    const bool BIDIRECTIONAL = true;
+#else
+    const bool BIDIRECTIONAL = false;
+#endif
+    const int MOTOR_POLES = 14; // magnets in the bell, eRPM / (poles / 2) = RPM
+#elif defined(MOTOR_PROTOCOL)
+    // The LEDC repeats the pulse at this rate on its own, it is not triggered
+    // by the regulator. 1 kHz matches the sensor rate, so a new value waits
+    // at most 1 ms for a pulse; when the loop falls behind the sensor, some
+    // pulses repeat the previous value.
+    const ServoProtocol PROTOCOL = MOTOR_PROTOCOL;
+    const int REFRESH_RATE = 1000; // Hz
+#else
+    const ServoProtocol PROTOCOL = SERVO_PWM;
+    const int REFRESH_RATE = 50; // Hz, standard ESC PWM
+#endif
+
+#if defined(MOTOR_DSHOT)
+    DShot escs[MOTORS_COUNT] = {
+        DShot((DShotMode)MOTOR_DSHOT, BIDIRECTIONAL),
+        DShot((DShotMode)MOTOR_DSHOT, BIDIRECTIONAL),
+        DShot((DShotMode)MOTOR_DSHOT, BIDIRECTIONAL),
+        DShot((DShotMode)MOTOR_DSHOT, BIDIRECTIONAL)};
+#else
+    Servo escs[MOTORS_COUNT];
+    Servo *group[MOTORS_COUNT] = {&escs[0], &escs[1], &escs[2], &escs[3]};
+#endif
+
+    void init()
+    {
+        for (int i = 0; i < MOTORS_COUNT; i++)
+        {
+#if defined(MOTOR_DSHOT)
+            bool attached = escs[i].attach(PINS[i]);
+#else
+            bool attached = escs[i].attach(PINS[i], PROTOCOL, REFRESH_RATE);
+#endif
+            if (!attached)
+            {
+                Log::error("Can't attach ESC " + String(i) + " on pin " + String(PINS[i]));
+            }
+        }
+
+        stop();
+    }
+
+    void write(const float *values, uint8_t count)
+    {
+        if (count > MOTORS_COUNT)
+        {
+            count = MOTORS_COUNT;
+        }
+
+#if defined(MOTOR_DSHOT)
+        // Straight from the float to the 2000 DShot steps; going through
+        // write(int) would leave only one step per whole motor unit
+        for (int i = 0; i < count; i++)
+        {
+            float value = constrain(values[i], 0.0f, 180.0f);
+            uint16_t throttle = 0;
+
+            if (value > 0.0f)
+            {
+                throttle = DSHOT_THROTTLE_MIN + (uint16_t)(value * (DSHOT_THROTTLE_MAX - DSHOT_THROTTLE_MIN) / 180.0f + 0.5f);
+            }
+
+            escs[i].writeThrottle(throttle);
+        }
+
+        // DShot has no free running timer, every update is an explicit frame
+        DShot::sendAll();
+#else
+        // All ESCs share one LEDC timer, so their new pulses start in the same period
+        float scaled[MOTORS_COUNT];
+
+        for (int i = 0; i < count; i++)
+        {
+            scaled[i] = values[i] / 180.0f;
+        }
+
+        Servo::writeScaledGroup(group, scaled, count);
+#endif
+    }
+
+    // Rotation frequency per motor in Hz from the ESC telemetry, 0 for motors
+    // without a recent reply. False when the ESCs can't report RPM at all.
+    bool readFrequencies(float *frequencies, uint8_t count)
+    {
+#if defined(MOTOR_DSHOT) && defined(MOTOR_DSHOT_BIDIR)
+        if (count > MOTORS_COUNT)
+        {
+            count = MOTORS_COUNT;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            uint32_t erpm;
+            frequencies[i] = escs[i].readErpm(erpm) ? erpm / (MOTOR_POLES / 2) / 60.0f : 0.0f;
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void stop()
+    {
+        const float zero[MOTORS_COUNT] = {0};
+        write(zero, MOTORS_COUNT);
+    }
+}
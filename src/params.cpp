@@ -0,0 +1,102 @@
+#include <Preferences.h>
+#include "params.h"
+#include "log.h"
+
+namespace Params
+{
+    static const char *NAMESPACE = "copter";
+    static const int MAX_PENDING = 16;
+    static const int MAX_KEY_LENGTH = 15; // NVS limit
+
+    typedef struct
+    {
+        char key[MAX_KEY_LENGTH + 1];
+        float value;
+    } PendingType;
+
+    Preferences preferences;
+
+    // set() runs on the control task, commit() on async_tcp
+    PendingType pending[MAX_PENDING];
+    int pendingCount = 0;
+    portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+
+    void init()
+    {
+        if (!preferences.begin(NAMESPACE, false))
+        {
+            Log::warning("Params: NVS not available, using defaults");
+        }
+    }
+
+    float get(const char *key, float fallback)
+    {
+        for (int i = 0; i < pendingCount; i++)
+        {
+            if (strcmp(pending[i].key, key) == 0)
+            {
+                return pending[i].value;
+            }
+        }
+
+        return preferences.getFloat(key, fallback);
+    }
+
+    void set(const char *key, float value)
+    {
+        bool full = false;
+
+        portENTER_CRITICAL(&pendingMux);
+
+        int i = 0;
+        while (i < pendingCount && strcmp(pending[i].key, key) != 0)
+        {
+            i++;
+        }
+
+        if (i < pendingCount)
+        {
+            pending[i].value = value;
+        }
+        else if (pendingCount >= MAX_PENDING)
+        {
+            full = true;
+        }
+        else
+        {
+            strncpy(pending[pendingCount].key, key, MAX_KEY_LENGTH);
+            pending[pendingCount].key[MAX_KEY_LENGTH] = 0;
+            pending[pendingCount].value = value;
+            pendingCount++;
+        }
+
+        portEXIT_CRITICAL(&pendingMux);
+
+        if (full)
+        {
+            Log::warning("Params: too many pending writes");
+        }
+    }
+
+    bool dirty()
+    {
+        return pendingCount > 0;
+    }
+
+    void commit()
+    {
+        PendingType writes[MAX_PENDING];
+        int count;
+
+        portENTER_CRITICAL(&pendingMux);
+        count = pendingCount;
+        memcpy(writes, pending, count * sizeof(PendingType));
+        pendingCount = 0;
+        portEXIT_CRITICAL(&pendingMux);
+
+        for (int i = 0; i < count; i++)
+        {
+            preferences.putFloat(writes[i].key, writes[i].value);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include <Arduino.h>
+#include "pid.h"
+#include "fastmath.h"
+
+namespace Pid
+{
+    void init(PidBankType &bank, float dCutoff)
+    {
+        memset(&bank, 0, sizeof(bank));
+
+        bank.dRc = 1.0f / (2.0f * FastMath::PI_F * dCutoff);
+
+        for (int i = 0; i < PID_AXES; i++)
+        {
+            bank.outputMin[i] = -1.0f;
+            bank.outputMax[i] = 1.0f;
+            bank.gainScale[i] = 1.0f;
+        }
+    }
+
+    void setGains(PidBankType &bank, int axis, float kp, float ki, float kd)
+    {
+        bank.kp[axis] = kp;
+        bank.ki[axis] = ki;
+        bank.kd[axis] = kd;
+
+        // Force the dt-derived terms to be recomputed
+        float dt = bank.dt;
+        bank.dt = 0.0f;
+        if (dt > 0.0f)
+        {
+            setDt(bank, dt);
+        }
+    }
+
+    void setLimits(PidBankType &bank, int axis, float min, float max)
+    {
+        bank.outputMin[axis] = min;
+        bank.outputMax[axis] = max;
+    }
+
+    // Two divisions for the whole bank, and none while dt is unchanged. The
+    // terms are exact for every dt, so jitter costs time rather than gain.
+    void setDt(PidBankType &bank, float dt)
+    {
+        if (dt <= 0.0f || dt == bank.dt)
+        {
+            return;
+        }
+
+        float invDt = 1.0f / dt;
+
+        for (int i = 0; i < PID_AXES; i++)
+        {
+            bank.kiDt[i] = bank.ki[i] * dt;
+            bank.kdInvDt[i] = bank.kd[i] * invDt;
+        }
+
+        bank.dAlpha = dt / (bank.dRc + dt);
+        bank.dt = dt;
+    }
+
+    void update(PidBankType &bank)
+    {
+        for (int i = 0; i < PID_AXES; i++)
+        {
+            // No derivative kick from whatever input was last seen before reset()
+            if (!bank.primed[i])
+            {
+                bank.prevInput[i] = bank.input[i];
+                bank.primed[i] = true;
+            }
+
+            float error = bank.setpoint[i] - bank.input[i];
+
+            float derivative = (bank.prevInput[i] - bank.input[i]) * bank.kdInvDt[i];
+            bank.prevInput[i] = bank.input[i];
+            bank.dTerm[i] += bank.dAlpha * (derivative - bank.dTerm[i]);
+
+            float proportionalDerivative = bank.gainScale[i] * (bank.kp[i] * error + bank.dTerm[i]);
+            float output = proportionalDerivative + bank.integral[i];
+
+            // Only integrate when it does not push a saturated output further out
+            bool saturatedHigh = output >= bank.outputMax[i] && error > 0.0f;
+            bool saturatedLow = output <= bank.outputMin[i] && error < 0.0f;
+
+            if (!saturatedHigh && !saturatedLow)
+            {
+                float integral = bank.integral[i] + bank.kiDt[i] * error;
+                bank.integral[i] = constrain(integral, bank.outputMin[i], bank.outputMax[i]);
+            }
+
+            output = proportionalDerivative + bank.integral[i];
+            bank.output[i] = constrain(output, bank.outputMin[i], bank.outputMax[i]);
+        }
+    }
+
+    void reset(PidBankType &bank)
+    {
+        for (int i = 0; i < PID_AXES; i++)
+        {
+            resetAxis(bank, i);
+        }
+    }
+
+    void resetAxis(PidBankType &bank, int axis)
+    {
+        bank.integral[axis] = 0.0f;
+        bank.dTerm[axis] = 0.0f;
+        bank.output[axis] = 0.0f;
+        bank.primed[axis] = false;
+    }
+}
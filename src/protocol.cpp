@@ -0,0 +1,144 @@
+#include <math.h>
+#include "protocol.h"
+
+// No Arduino dependency, so the host tests can build it too
+namespace Protocol
+{
+    static float clamp(float value, float min, float max)
+    {
+        return value < min ? min : (value > max ? max : value);
+    }
+
+    static uint16_t encodeSigned(float value, float scale)
+    {
+        return (uint16_t)(int16_t)lroundf(clamp(value * scale, -32768.0f, 32767.0f));
+    }
+
+    static uint16_t encodeUnsigned(float value, float scale)
+    {
+        return (uint16_t)lroundf(clamp(value * scale, 0.0f, 65535.0f));
+    }
+
+    static uint16_t encodeChannel(float value)
+    {
+        return encodeSigned(value, PROTOCOL_CHANNEL_SCALE);
+    }
+
+    // Every step is a fixed number of operations, so a frame costs the same
+    // to check whatever it holds.
+    uint16_t crc16(const uint8_t *data, size_t len)
+    {
+        uint16_t crc = 0xFFFF;
+
+        for (size_t i = 0; i < len; i++)
+        {
+            crc ^= (uint16_t)data[i] << 8;
+
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                crc = (crc << 1) ^ ((crc & 0x8000) ? 0x1021 : 0);
+            }
+        }
+
+        return crc;
+    }
+
+    bool decodeControl(const uint8_t *data, size_t len, ControlFrameType &frame)
+    {
+        if (len != PROTOCOL_CONTROL_SIZE || data[0] != PROTOCOL_VERSION)
+        {
+            return false;
+        }
+
+        if (crc16(data, PROTOCOL_CONTROL_SIZE - 2) != readU16(data + PROTOCOL_CONTROL_SIZE - 2))
+        {
+            return false;
+        }
+
+        frame.flags = data[1];
+        frame.sequence = readU32(data + 2);
+        frame.clientTimestamp = readU32(data + 6);
+        frame.throttle = (float)(int16_t)readU16(data + 10) / PROTOCOL_CHANNEL_SCALE;
+        frame.pitch = (float)(int16_t)readU16(data + 12) / PROTOCOL_CHANNEL_SCALE;
+        frame.roll = (float)(int16_t)readU16(data + 14) / PROTOCOL_CHANNEL_SCALE;
+        frame.yaw = (float)(int16_t)readU16(data + 16) / PROTOCOL_CHANNEL_SCALE;
+
+        return true;
+    }
+
+    size_t encodeControl(const ControlFrameType &frame, uint8_t *data)
+    {
+        data[0] = PROTOCOL_VERSION;
+        data[1] = frame.flags;
+        writeU32(data + 2, frame.sequence);
+        writeU32(data + 6, frame.clientTimestamp);
+        writeU16(data + 10, encodeChannel(frame.throttle));
+        writeU16(data + 12, encodeChannel(frame.pitch));
+        writeU16(data + 14, encodeChannel(frame.roll));
+        writeU16(data + 16, encodeChannel(frame.yaw));
+        writeU16(data + 18, crc16(data, PROTOCOL_CONTROL_SIZE - 2));
+
+        return PROTOCOL_CONTROL_SIZE;
+    }
+
+    size_t encodeTelemetry(const TelemetryFrameType &frame, uint8_t *data)
+    {
+        data[0] = PROTOCOL_VERSION;
+        data[1] = frame.flags;
+        writeU32(data + 2, frame.sequence);
+        writeU32(data + 6, frame.timestamp);
+        writeU32(data + 10, frame.clientTimestamp);
+
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            writeU16(data + 14 + i * 2, encodeSigned(frame.angles[i], 100.0f));
+            writeU16(data + 20 + i * 2, encodeSigned(frame.rates[i], 10.0f));
+            writeU16(data + 38 + i * 2, encodeUnsigned(frame.vibration[i], 1000.0f));
+            writeU16(data + 44 + i * 2, encodeUnsigned(frame.vibrationPeak[i], 1000.0f));
+        }
+
+        for (uint8_t i = 0; i < PROTOCOL_TELEMETRY_MOTORS; i++)
+        {
+            writeU16(data + 26 + i * 2, encodeUnsigned(frame.motors[i], 100.0f));
+        }
+
+        writeU16(data + 34, encodeUnsigned(frame.throttle, 100.0f));
+        data[36] = (uint8_t)lroundf(clamp(frame.accelTrust, 0.0f, 1.0f) * 255.0f);
+        data[37] = (uint8_t)lroundf(clamp(frame.linkQuality, 0.0f, 1.0f) * 255.0f);
+        writeU16(data + 50, (uint16_t)(frame.clipCount < 65535 ? frame.clipCount : 65535));
+        writeU16(data + 52, encodeUnsigned(frame.cellVoltage, 1000.0f));
+        writeU16(data + 54, crc16(data, PROTOCOL_TELEMETRY_SIZE - 2));
+
+        return PROTOCOL_TELEMETRY_SIZE;
+    }
+
+    // Serial number comparison, so the sequence may wrap.
+    bool isNewer(uint32_t sequence, uint32_t last)
+    {
+        return (int32_t)(sequence - last) > 0;
+    }
+
+    uint16_t readU16(const uint8_t *data)
+    {
+        return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+    }
+
+    uint32_t readU32(const uint8_t *data)
+    {
+        return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    void writeU16(uint8_t *data, uint16_t value)
+    {
+        data[0] = value;
+        data[1] = value >> 8;
+    }
+
+    void writeU32(uint8_t *data, uint32_t value)
+    {
+        data[0] = value;
+        data[1] = value >> 8;
+        data[2] = value >> 16;
+        data[3] = value >> 24;
+    }
+}
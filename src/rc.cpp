@@ -1,51 +1,201 @@
 #include <Arduino.h>
 
-#include "GyverPID.h"
+#include "pid.h"
+#include "mixer.h"
+#include "autotune.h"
+#include "params.h"
+#include "lut.h"
+#include "filter.h"
+#include "motors.h"
+#include "udplink.h"
+#include "telemetry.h"
 
 #include "rc.h"
 #include "log.h"
 #include "imu.h"
+#include "timing.h"
 
 namespace Rc
 {
     const char *SSID = "CopterAP";
     const char *PASSWORD = "123";
-
-    const int ESC_PIN1 = 26;
-    const int ESC_PIN2 = 25;
-    const int ESC_PIN3 = 32;
-    const int ESC_PIN4 = 33;
+    const uint16_t UDP_PORT = 4210; // binary control frames, see udplink.h
 
     const float MIN_ANGLE = 1;  // deg
     const float MAX_ANGLE = 25.0; // deg
     const int MAX_MOTOR_VALUE = 150;
 
-    Servo ESC1;
-    Servo ESC2;
-    Servo ESC3;
-    Servo ESC4;
-
-    const float KP = 2.5;
-    const float KI = 0;
-    const float KD = 2;
-
-    GyverPID regulatorPitch(KP, KI, KD);
-    GyverPID regulatorRoll(KP, KI, KD);
-    GyverPID regulatorYaw(KP, KI, KD);
-    int16_t lastRegulatorUpdate = millis();
+    // Angle loop: deg of error -> deg/s of rate setpoint
+    const float ANGLE_KP = 4.0;
+    const float ANGLE_KI = 0;
+    const float ANGLE_KD = 0;
+    const int MAX_RATE = 200; // deg/s
+    const float ANGLE_D_CUTOFF = 40.0; // Hz
+    const uint8_t ANGLE_LOOP_DIVIDER = 4; // 250 Hz, attitude moves far slower than rate
+
+    // Rate loops: deg/s of error -> motor correction
+    const float RATE_KP = 0.6;
+    const float RATE_KI = 0.5;
+    const float RATE_KD = 0.01;
+
+    const float YAW_KP = 1.0;
+    const float YAW_KI = 0.5;
+    const float YAW_KD = 0;
+
+    const float RATE_D_CUTOFF = 80.0; // Hz
+
+    PidBankType angleRegulators; // roll and pitch only, yaw has no angle loop
+    uint8_t angleLoopCount = 0;
+    float angleLoopDt = 0; // s since the angle loop last ran
+    PidBankType rateRegulators; // yaw axis is driven by the yaw stick in deg/s
+
+    // Loop gain grows with thrust, so roll / pitch P and D are attenuated as
+    // throttle goes up (0 .. MAX_MOTOR_VALUE) and boosted as the pack sags
+    // (per cell volts, BATTERY_CELL_EMPTY .. BATTERY_CELL_FULL).
+    const float THROTTLE_GAIN_SCHEDULE[] = {1.0, 1.0, 1.0, 0.95, 0.9, 0.8, 0.7};
+    const float VOLTAGE_GAIN_SCHEDULE[] = {1.2, 1.1, 1.05, 1.0};
+
+    const int BATTERY_PIN = -1; // ADC pin behind BATTERY_DIVIDER, -1 when not wired
+    const float BATTERY_DIVIDER = 11.0;
+    const int BATTERY_CELLS = 3;
+    const float BATTERY_CELL_EMPTY = 3.3; // V
+    const float BATTERY_CELL_FULL = 4.2;  // V
+    const uint32_t BATTERY_SAMPLE_PERIOD = 50; // ms, an ADC read takes too long for every cycle
+    const float BATTERY_LPF_CUTOFF = 1.0;      // Hz, follows the pack rather than every throttle punch
+
+    LutType throttleGainSchedule;
+    LutType voltageGainSchedule;
+    BiquadType batteryLowPass;
+    uint32_t lastBatterySample = 0;
+    float batteryCellVoltage = BATTERY_CELL_FULL;
+
+    // Pilot throttle stick (0..180) -> throttle, Betaflight style mid / expo
+    const float THROTTLE_MID = 0.5;
+    const float THROTTLE_EXPO = 0.0;
+
+    // Props give thrust ~ command^2; 0 keeps motors linear, 1 undoes a pure square
+    const float THRUST_LINEAR = 0.3;
+
+    const int CURVE_POINTS = LUT_MAX_POINTS;
+
+    LutBufferType throttleCurve;
+    LutBufferType thrustLinearization;
+
+    const char *RATE_GAIN_KEYS[PID_AXES][3] = {
+        {"roll_kp", "roll_ki", "roll_kd"},
+        {"pitch_kp", "pitch_ki", "pitch_kd"},
+        {"yaw_kp", "yaw_ki", "yaw_kd"}};
+
+    const float AUTOTUNE_RELAY = 20.0;     // motor units
+    const float AUTOTUNE_HYSTERESIS = 2.0; // deg/s
+    const uint8_t AUTOTUNE_CYCLES = 5;
+    const float AUTOTUNE_TIMEOUT = 10.0; // s
+
+    AutotuneType autotune;
+    int autotuneAxis = -1; // axis being tuned, control loop only
+
+    // Written by the async_tcp task only: the axis, then the count
+    volatile int autotuneRequest = -1;
+    volatile uint32_t autotuneRequestCount = 0;
+    uint32_t autotuneRequestsHandled = 0;
+
+    volatile bool paramsCommitQueued = false;
+    TimestampType lastRegulatorTimestamp = 0;
 
     AsyncWebServer server(80);
     AsyncWebSocket ws("/ws");
 
-    int throttle = 0;
-    int pitch = 0;
-    int roll = 0;
-    int yaw = 0;
+    // Binary control frames older than the last one applied are dropped
+    uint32_t lastControlSequence = 0;
+    bool controlSequenceValid = false;
+    uint32_t lastControlTimestamp = 0; // client clock, echoed in telemetry
+
+    uint32_t telemetrySequence = 0;
+
+    float throttle = 0;
+    float pitch = 0;
+    float roll = 0;
+    float yaw = 0;
+
+    MixerType mixer;
+    float motors[MIXER_MAX_MOTORS] = {0}; // front right, rear right, rear left, front left
+
+    const uint32_t DEBUG_PRINT_PERIOD = 50; // ms
+    uint32_t lastDebugPrint = 0;
+
+    // Rebuilds the spare table and swaps it in; safe while process() runs.
+    // False, and nothing changes, while the control loop still reads the spare.
+    bool setThrottleCurve(float mid, float expo)
+    {
+        LutType *spare = Lut::spare(throttleCurve);
+        if (spare == NULL)
+        {
+            return false;
+        }
+
+        mid = constrain(mid, 0.05f, 0.95f);
+        expo = constrain(expo, 0.0f, 1.0f);
+
+        float values[CURVE_POINTS];
+
+        for (int i = 0; i < CURVE_POINTS; i++)
+        {
+            float stick = (float)i / (CURVE_POINTS - 1);
+            float range = stick < mid ? mid : 1.0f - mid;
+            float relative = (stick - mid) / range;
+
+            relative = (1.0f - expo) * relative + expo * relative * relative * relative;
+            values[i] = (mid + relative * range) * MAX_MOTOR_VALUE;
+        }
+
+        Lut::init(*spare, 0, 180, values, CURVE_POINTS);
+        Lut::publish(throttleCurve);
+        return true;
+    }
+
+    // Inverse of thrust = (1 - k) * command + k * command^2, both normalised.
+    bool setThrustLinear(float k)
+    {
+        LutType *spare = Lut::spare(thrustLinearization);
+        if (spare == NULL)
+        {
+            return false;
+        }
+
+        k = constrain(k, 0.0f, 1.0f);
 
-    int motorFrontRight = 0;
-    int motorRearRight = 0;
-    int motorRearLeft = 0;
-    int motorFrontLeft = 0;
+        float values[CURVE_POINTS];
+
+        for (int i = 0; i < CURVE_POINTS; i++)
+        {
+            float thrust = (float)i / (CURVE_POINTS - 1);
+            float command = thrust;
+
+            if (k > 0.0f)
+            {
+                command = (sqrtf((1.0f - k) * (1.0f - k) + 4.0f * k * thrust) - (1.0f - k)) / (2.0f * k);
+            }
+
+            values[i] = command * MAX_MOTOR_VALUE;
+        }
+
+        Lut::init(*spare, 0, MAX_MOTOR_VALUE, values, CURVE_POINTS);
+        Lut::publish(thrustLinearization);
+        return true;
+    }
+
+    void loadRateGains(int axis, float kp, float ki, float kd)
+    {
+        Pid::setGains(rateRegulators, axis,
+                      Params::get(RATE_GAIN_KEYS[axis][0], kp),
+                      Params::get(RATE_GAIN_KEYS[axis][1], ki),
+                      Params::get(RATE_GAIN_KEYS[axis][2], kd));
+    }
+
+    float readCellVoltage()
+    {
+        return analogReadMilliVolts(BATTERY_PIN) * 0.001f * BATTERY_DIVIDER / BATTERY_CELLS;
+    }
 
     void init()
     {
@@ -57,123 +207,386 @@ namespace Rc
         Log::info(myIP);
 
         ws.onEvent(onEvent);
+        ws.onMessage(handleWebSocketMessage);
+        ws.stateChannels(stateChannel);
+        // No Nagle or modem sleep on stick input, and a dead link drops in seconds
+        ws.connectionProfile(WS_PROFILE_REALTIME);
         server.addHandler(&ws);
 
         server.begin();
 
-        ESC1.attach(ESC_PIN1, 1000, 2000);
-        ESC2.attach(ESC_PIN2, 1000, 2000);
-        ESC3.attach(ESC_PIN3, 1000, 2000);
-        ESC4.attach(ESC_PIN4, 1000, 2000);
+        UdpLink::init(UDP_PORT, applyControl);
+
+        Motors::init();
 
         pinMode(LED_BUILTIN, OUTPUT);
 
-        regulatorPitch.setLimits(-1 * MAX_MOTOR_VALUE, MAX_MOTOR_VALUE);
-        regulatorRoll.setLimits(-1 * MAX_MOTOR_VALUE, MAX_MOTOR_VALUE);
+        Mixer::init(mixer, FRAME_QUAD_X, 0, MAX_MOTOR_VALUE);
+
+        Pid::init(angleRegulators, ANGLE_D_CUTOFF);
+        Pid::setGains(angleRegulators, PID_ROLL, ANGLE_KP, ANGLE_KI, ANGLE_KD);
+        Pid::setGains(angleRegulators, PID_PITCH, ANGLE_KP, ANGLE_KI, ANGLE_KD);
+        Pid::setLimits(angleRegulators, PID_ROLL, -1 * MAX_RATE, MAX_RATE);
+        Pid::setLimits(angleRegulators, PID_PITCH, -1 * MAX_RATE, MAX_RATE);
+        Pid::setLimits(angleRegulators, PID_YAW, 0, 0);
+
+        Params::init();
+
+        Lut::init(throttleGainSchedule, 0, MAX_MOTOR_VALUE, THROTTLE_GAIN_SCHEDULE, sizeof(THROTTLE_GAIN_SCHEDULE) / sizeof(float));
+        Lut::init(voltageGainSchedule, BATTERY_CELL_EMPTY, BATTERY_CELL_FULL, VOLTAGE_GAIN_SCHEDULE, sizeof(VOLTAGE_GAIN_SCHEDULE) / sizeof(float));
+
+        Filter::initLowPass(batteryLowPass, 1000.0f / BATTERY_SAMPLE_PERIOD, BATTERY_LPF_CUTOFF);
+        if (BATTERY_PIN >= 0)
+        {
+            batteryCellVoltage = readCellVoltage();
+        }
+        Filter::reset(batteryLowPass, batteryCellVoltage);
+
+        setThrottleCurve(THROTTLE_MID, THROTTLE_EXPO);
+        setThrustLinear(THRUST_LINEAR);
+
+        Pid::init(rateRegulators, RATE_D_CUTOFF);
+        loadRateGains(PID_ROLL, RATE_KP, RATE_KI, RATE_KD);
+        loadRateGains(PID_PITCH, RATE_KP, RATE_KI, RATE_KD);
+        loadRateGains(PID_YAW, YAW_KP, YAW_KI, YAW_KD);
+
+        for (int axis = 0; axis < PID_AXES; axis++)
+        {
+            Pid::setLimits(rateRegulators, axis, -1 * MAX_MOTOR_VALUE, MAX_MOTOR_VALUE);
+        }
     }
 
-    void process()
+    // The tuned axis integrated and differentiated the relay's motion
+    // rather than its own, so only that axis starts over
+    void stopAutotune()
+    {
+        Pid::resetAxis(rateRegulators, autotuneAxis);
+        autotuneAxis = -1;
+    }
+
+    void updateAutotune(float dt)
+    {
+        rateRegulators.output[autotuneAxis] = Autotune::update(autotune, rateRegulators.input[autotuneAxis], dt);
+
+        if (autotune.state == AUTOTUNE_DONE)
+        {
+            // Tuned at the current throttle, store gains as unscheduled
+            float scale = rateRegulators.gainScale[autotuneAxis];
+            float kp = autotune.kp / scale;
+            float kd = autotune.kd / scale;
+
+            Pid::setGains(rateRegulators, autotuneAxis, kp, autotune.ki, kd);
+
+            // Written to flash once disarmed
+            Params::set(RATE_GAIN_KEYS[autotuneAxis][0], kp);
+            Params::set(RATE_GAIN_KEYS[autotuneAxis][1], autotune.ki);
+            Params::set(RATE_GAIN_KEYS[autotuneAxis][2], kd);
+        }
+
+        if (autotune.state != AUTOTUNE_RUNNING)
+        {
+            if (autotune.state == AUTOTUNE_FAILED)
+            {
+                Log::warning("Autotune failed");
+            }
+
+            stopAutotune();
+        }
+    }
+
+    void updateBatteryVoltage()
     {
-        ws.cleanupClients();
+        if (BATTERY_PIN < 0 || millis() - lastBatterySample < BATTERY_SAMPLE_PERIOD)
+        {
+            return;
+        }
 
+        lastBatterySample = millis();
+        batteryCellVoltage = Filter::apply(batteryLowPass, readCellVoltage());
+    }
+
+    void updateGainSchedule()
+    {
+        float scale = Lut::lookup(throttleGainSchedule, throttle) * Lut::lookup(voltageGainSchedule, batteryCellVoltage);
+
+        rateRegulators.gainScale[PID_ROLL] = scale;
+        rateRegulators.gainScale[PID_PITCH] = scale;
+    }
+
+    void updateRegulators(float dt)
+    {
         AxisType angles = Imu::getDegAngles();
+        AxisType rates = Imu::getDegRates();
 
         angles.x = min(angles.x, MAX_ANGLE);
         angles.y = min(angles.y, MAX_ANGLE);
 
-        regulatorPitch.setpoint = pitch;
-        regulatorRoll.setpoint = roll;
+        // Outer loop: angle error -> rate setpoint, on every
+        // ANGLE_LOOP_DIVIDER-th sample over the time since it last ran
+        angleLoopDt += dt;
 
-        if (throttle > 0)
+        if (angleLoopCount == 0)
         {
-            regulatorPitch.input = abs(angles.y) > MIN_ANGLE ? angles.y : 0;
-            regulatorRoll.input = abs(angles.x) > MIN_ANGLE ? angles.x : 0;
-        }
-        else
-        {
-            regulatorPitch.input = 0;
-            regulatorRoll.input = 0;
+            angleRegulators.setpoint[PID_ROLL] = roll;
+            angleRegulators.input[PID_ROLL] = abs(angles.x) > MIN_ANGLE ? angles.x : 0;
+
+            angleRegulators.setpoint[PID_PITCH] = pitch;
+            angleRegulators.input[PID_PITCH] = abs(angles.y) > MIN_ANGLE ? angles.y : 0;
+
+            Pid::setDt(angleRegulators, angleLoopDt);
+            Pid::update(angleRegulators);
+            angleLoopDt = 0;
         }
 
-        int16_t dt = millis() - lastRegulatorUpdate;
-        regulatorPitch.setDt(dt);
-        regulatorPitch.getResult();
+        angleLoopCount = (angleLoopCount + 1) % ANGLE_LOOP_DIVIDER;
 
-        regulatorRoll.setDt(dt);
-        regulatorRoll.getResult();
+        // Inner loop: rate error -> motor correction, on every gyro sample
+        rateRegulators.setpoint[PID_ROLL] = angleRegulators.output[PID_ROLL];
+        rateRegulators.setpoint[PID_PITCH] = angleRegulators.output[PID_PITCH];
+        rateRegulators.setpoint[PID_YAW] = yaw;
 
-        lastRegulatorUpdate = millis();
+        rateRegulators.input[PID_ROLL] = rates.x;
+        rateRegulators.input[PID_PITCH] = rates.y;
+        rateRegulators.input[PID_YAW] = rates.z;
 
-        float M_RATE = 0.8;
+        updateBatteryVoltage();
+        updateGainSchedule();
 
-        motorFrontRight = abs(throttle - (regulatorRoll.output * M_RATE) - (regulatorPitch.output * M_RATE) - yaw);
-        motorRearRight = abs(throttle - (regulatorRoll.output * M_RATE) + (regulatorPitch.output * M_RATE) + yaw);
-        motorRearLeft = abs(throttle + (regulatorRoll.output * M_RATE) + (regulatorPitch.output * M_RATE) - yaw);
-        motorFrontLeft = abs(throttle + (regulatorRoll.output * M_RATE) - (regulatorPitch.output * M_RATE) + yaw);
+        Pid::setDt(rateRegulators, dt);
+        Pid::update(rateRegulators);
+
+        if (autotuneAxis >= 0)
+        {
+            updateAutotune(dt);
+        }
+    }
+
+    // Runs on the async_tcp task
+    void commitParams(void *)
+    {
+        paramsCommitQueued = false;
+        Params::commit();
+    }
+
+    void debugPrint()
+    {
+        if (millis() - lastDebugPrint < DEBUG_PRINT_PERIOD)
+        {
+            return;
+        }
+
+        lastDebugPrint = millis();
 
         Serial.print("Setpoint:");
-        Serial.print(regulatorRoll.setpoint);
+        Serial.print(angleRegulators.setpoint[PID_ROLL]);
         Serial.print(",");
 
         Serial.print("InputX:");
-        Serial.print(regulatorRoll.input);
+        Serial.print(angleRegulators.input[PID_ROLL]);
         Serial.print(",");
 
         Serial.print("Input Y:");
-        Serial.print(regulatorPitch.input);
+        Serial.print(angleRegulators.input[PID_PITCH]);
+        Serial.print(",");
+
+        Serial.print("RateX:");
+        Serial.print(rateRegulators.input[PID_ROLL]);
+        Serial.print(",");
+
+        Serial.print("RateY:");
+        Serial.print(rateRegulators.input[PID_PITCH]);
         Serial.print(",");
 
         // Serial.print("motorFrontRight:");
-        // Serial.print(motorFrontRight);
+        // Serial.print(motors[0]);
         // Serial.print(",");
 
         // Serial.print("motorRearRight:");
-        // Serial.print(motorRearRight);
+        // Serial.print(motors[1]);
         // Serial.print(",");
 
         // Serial.print("motorRearLeft:");
-        // Serial.print(motorRearLeft);
+        // Serial.print(motors[2]);
         // Serial.print(",");
 
         // Serial.print("motorFrontLeft:");
-        // Serial.println(motorFrontLeft);
+        // Serial.println(motors[3]);
 
         Serial.print("OutputX:");
-        Serial.print(regulatorRoll.output);
+        Serial.print(rateRegulators.output[PID_ROLL]);
         Serial.print(",");
 
         Serial.print("Output Y:");
-        Serial.println(regulatorPitch.output);
+        Serial.println(rateRegulators.output[PID_PITCH]);
+    }
+
+    void process()
+    {
+        if (UdpLink::lost())
+        {
+            Log::warning("UDP control link lost");
+            emergencyStop();
+        }
+
+        TimestampType sampleTimestamp = Imu::getTimestamp();
+
+        if (sampleTimestamp == lastRegulatorTimestamp)
+        {
+            return;
+        }
+
+        uint32_t requests = autotuneRequestCount;
+
+        if (requests != autotuneRequestsHandled)
+        {
+            __sync_synchronize(); // the count before the axis it publishes
+            int request = autotuneRequest;
+            autotuneRequestsHandled = requests;
+
+            if (autotuneAxis >= 0)
+            {
+                stopAutotune();
+            }
+
+            if (request >= 0 && request < PID_AXES && throttle > 0)
+            {
+                Autotune::start(autotune, 0, AUTOTUNE_RELAY, AUTOTUNE_HYSTERESIS, AUTOTUNE_CYCLES, AUTOTUNE_TIMEOUT);
+                autotuneAxis = request;
+            }
+        }
 
-        // motorFrontRight = throttle - roll - pitch - yaw;
-        // motorRearRight = throttle - roll + pitch + yaw;
-        // motorRearLeft = throttle + roll + pitch - yaw;
-        // motorFrontLeft = throttle + roll - pitch + yaw;
+        if (throttle <= 0)
+        {
+            // Angle loop D starts from the next measured attitude, not the last one
+            Pid::reset(angleRegulators);
+            angleLoopCount = 0;
+            angleLoopDt = 0;
+            Pid::reset(rateRegulators);
+
+            autotuneAxis = -1;
+
+            // Flash writes take milliseconds, too long for the control loop
+            if (Params::dirty() && !__sync_lock_test_and_set(&paramsCommitQueued, true))
+            {
+                if (!async_tcp_call(commitParams, NULL))
+                {
+                    paramsCommitQueued = false;
+                }
+            }
+        }
+        else if (lastRegulatorTimestamp != 0)
+        {
+            updateRegulators(Timing::toSeconds(sampleTimestamp - lastRegulatorTimestamp));
+        }
+
+        lastRegulatorTimestamp = sampleTimestamp;
+
+        Mixer::mix(mixer, throttle, rateRegulators.output[PID_ROLL], rateRegulators.output[PID_PITCH], rateRegulators.output[PID_YAW], motors);
+
+        const LutType &linearization = Lut::acquire(thrustLinearization);
+
+        for (uint8_t i = 0; i < mixer.motorCount; i++)
+        {
+            motors[i] = Lut::lookup(linearization, motors[i]);
+        }
+
+        Lut::release(thrustLinearization, linearization);
 
-        motorFrontRight = min(MAX_MOTOR_VALUE, motorFrontRight);
-        motorRearRight = min(MAX_MOTOR_VALUE, motorRearRight);
-        motorRearLeft = min(MAX_MOTOR_VALUE, motorRearLeft);
-        motorFrontLeft = min(MAX_MOTOR_VALUE, motorFrontLeft);
+        debugPrint();
+
+        Motors::write(motors, mixer.motorCount);
+
+        // Gyro notches follow the motors for the samples of the next cycle
+        float motorFrequencies[MIXER_MAX_MOTORS];
+        if (Motors::readFrequencies(motorFrequencies, mixer.motorCount))
+        {
+            Imu::setMotorFrequencies(motorFrequencies, mixer.motorCount);
+        }
 
-        ESC1.write(motorFrontRight);
-        ESC2.write(motorRearRight);
-        ESC3.write(motorRearLeft);
-        ESC4.write(motorFrontLeft);
+        sendTelemetry();
     }
 
-    void handleWebSocketMessage(void *arg, uint8_t *data, size_t len)
+    void sendTelemetry()
     {
-        AwsFrameInfo *info = (AwsFrameInfo *)arg;
+        if (!Telemetry::due())
+        {
+            return;
+        }
 
-        if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT)
+        TelemetryFrameType frame;
+        AxisType angles = Imu::getDegAngles();
+        AxisType rates = Imu::getDegRates();
+        VibrationType vibration = Imu::getVibration();
+
+        frame.flags = (throttle > 0 ? PROTOCOL_TELEMETRY_ARMED : 0) |
+                      (autotuneAxis >= 0 ? PROTOCOL_TELEMETRY_AUTOTUNE : 0) |
+                      (UdpLink::active() ? PROTOCOL_TELEMETRY_UDP : 0);
+        frame.sequence = telemetrySequence++;
+        frame.timestamp = millis();
+        frame.clientTimestamp = lastControlTimestamp;
+
+        frame.angles[0] = angles.x;
+        frame.angles[1] = angles.y;
+        frame.angles[2] = angles.z;
+        frame.rates[0] = rates.x;
+        frame.rates[1] = rates.y;
+        frame.rates[2] = rates.z;
+
+        for (uint8_t i = 0; i < PROTOCOL_TELEMETRY_MOTORS; i++)
         {
-            data[len] = 0;
+            frame.motors[i] = i < mixer.motorCount ? motors[i] : 0.0f;
+        }
 
-            StaticJsonDocument<200> doc;
+        frame.throttle = throttle;
+        frame.accelTrust = Imu::getAccelTrust().trust;
+        frame.linkQuality = UdpLink::getStats().quality;
+        frame.vibration[0] = vibration.x.rms;
+        frame.vibration[1] = vibration.y.rms;
+        frame.vibration[2] = vibration.z.rms;
+        frame.vibrationPeak[0] = vibration.x.windowPeak;
+        frame.vibrationPeak[1] = vibration.y.windowPeak;
+        frame.vibrationPeak[2] = vibration.z.windowPeak;
+        frame.clipCount = vibration.x.windowClipCount + vibration.y.windowClipCount + vibration.z.windowClipCount;
+        frame.cellVoltage = batteryCellVoltage;
+
+        uint8_t data[PROTOCOL_TELEMETRY_SIZE];
+        size_t len = Protocol::encodeTelemetry(frame, data);
+
+        Telemetry::send(ws, data, len);
+    }
+
+    // Called with whole messages only, data points straight into the received segment
+    void handleWebSocketMessage(AsyncWebSocket *server, AsyncWebSocketClient *client, uint8_t opcode, const uint8_t *data, size_t len)
+    {
+        // Binary control frame, see protocol.h
+        if (opcode == WS_BINARY)
+        {
+            ControlFrameType frame;
+
+            if (!Protocol::decodeControl(data, len, frame))
+            {
+                Log::warning("Invalid control frame");
+                return;
+            }
+
+            if (controlSequenceValid && !Protocol::isNewer(frame.sequence, lastControlSequence))
+            {
+                return;
+            }
 
-            char *json = (char *)data;
+            lastControlSequence = frame.sequence;
+            controlSequenceValid = true;
 
-            DeserializationError error = deserializeJson(doc, json);
+            applyControl(frame);
+            return;
+        }
+
+        // JSON fallback for clients that didn't take up the binary protocol
+        if (opcode == WS_TEXT)
+        {
+            StaticJsonDocument<200> doc;
+
+            DeserializationError error = deserializeJson(doc, (const char *)data, len);
 
             if (error)
             {
@@ -181,27 +594,100 @@ namespace Rc
                 return;
             }
 
-            throttle = map(doc["throttle"], 0, 180, 0, MAX_MOTOR_VALUE);
-            pitch = doc["pitch"];
-            roll = doc["roll"];
-            yaw = doc["yaw"];
+            // {"telemetry": hz} sets this client's telemetry rate, 0 stops it
+            if (doc.containsKey("telemetry"))
+            {
+                Telemetry::setRate(client->id(), doc["telemetry"]);
+                return;
+            }
+
+            // {"autotune": 0|1|2} tunes the roll/pitch/yaw rate loop in flight, -1 stops
+            if (doc.containsKey("autotune"))
+            {
+                autotuneRequest = doc["autotune"];
+                __sync_synchronize(); // the axis before the count
+                autotuneRequestCount++;
+                return;
+            }
+
+            // {"throttle_mid": 0..1, "throttle_expo": 0..1} and {"thrust_linear": 0..1} retune the output curves
+            if (doc.containsKey("throttle_mid") || doc.containsKey("throttle_expo"))
+            {
+                // Rejected rather than waited for on the async_tcp task; a reader
+                // holds the spare for one lookup at most, so sending again works
+                if (!setThrottleCurve(doc["throttle_mid"] | THROTTLE_MID, doc["throttle_expo"] | THROTTLE_EXPO))
+                {
+                    Log::warning("Throttle curve busy, not changed");
+                }
+                return;
+            }
+
+            if (doc.containsKey("thrust_linear"))
+            {
+                if (!setThrustLinear(doc["thrust_linear"]))
+                {
+                    Log::warning("Thrust linearization busy, not changed");
+                }
+                return;
+            }
+
+            ControlFrameType frame = {0};
+            frame.throttle = doc["throttle"];
+            frame.pitch = doc["pitch"];
+            frame.roll = doc["roll"];
+            frame.yaw = doc["yaw"];
+
+            applyControl(frame);
         }
     }
 
+    // Binary control frames carry the whole stick state, so when a burst
+    // arrives only the newest one is worth parsing
+    int stateChannel(const AwsFrameInfo &info)
+    {
+        if (info.opcode == WS_BINARY && info.len == PROTOCOL_CONTROL_SIZE)
+        {
+            return 0;
+        }
+
+        return -1;
+    }
+
+    // Single entry for stick input, whatever transport it came over
+    void applyControl(const ControlFrameType &frame)
+    {
+        if (frame.flags & PROTOCOL_FLAG_STOP)
+        {
+            emergencyStop();
+            return;
+        }
+
+        lastControlTimestamp = frame.clientTimestamp;
+        throttle = Lut::lookup(throttleCurve, frame.throttle);
+        pitch = frame.pitch;
+        roll = frame.roll;
+        yaw = frame.yaw;
+    }
+
     void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
     {
         switch (type)
         {
         case WS_EVT_CONNECT:
             digitalWrite(LED_BUILTIN, HIGH);
+            controlSequenceValid = false;
+            Telemetry::addClient(client->id());
+            // Offer the binary protocol; clients that don't know it keep sending JSON
+            client->text("{\"protocol\":" + String(PROTOCOL_VERSION) + "}");
             //Serial.printf("WebSocket client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
             break;
         case WS_EVT_DISCONNECT:
+            Telemetry::removeClient(client->id());
             emergencyStop();
             //Serial.printf("WebSocket client #%u disconnected\n", client->id());
             break;
         case WS_EVT_DATA:
-            handleWebSocketMessage(arg, data, len);
+            // Delivered whole through handleWebSocketMessage
             break;
         case WS_EVT_PONG:
         case WS_EVT_ERROR:
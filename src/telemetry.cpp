@@ -0,0 +1,172 @@
+#include "telemetry.h"
+#include "udplink.h"
+
+namespace Telemetry
+{
+    static const float DEFAULT_RATE = 10.0f; // Hz, until the client asks for something else
+    static const float MAX_RATE = 100.0f;    // Hz
+    static const float UDP_RATE = 50.0f;     // Hz, to whoever sends control over UDP
+
+    TelemetryClientType clients[TELEMETRY_MAX_CLIENTS];
+    uint32_t udpLastSent = 0;
+
+    // Latest frame from the control task, picked up by flush() on async_tcp
+    uint8_t snapshot[TELEMETRY_MAX_FRAME];
+    size_t snapshotLength = 0;
+    portMUX_TYPE snapshotMux = portMUX_INITIALIZER_UNLOCKED;
+    volatile bool flushQueued = false;
+
+    static uint32_t rateToPeriod(float hz)
+    {
+        if (hz <= 0.0f)
+        {
+            return 0;
+        }
+
+        return (uint32_t)(1000.0f / min(hz, MAX_RATE));
+    }
+
+    static bool isDue(uint32_t period, uint32_t lastSent, uint32_t now)
+    {
+        return period > 0 && now - lastSent >= period;
+    }
+
+    static TelemetryClientType *find(uint32_t id)
+    {
+        for (uint8_t i = 0; i < TELEMETRY_MAX_CLIENTS; i++)
+        {
+            if (clients[i].id == id)
+            {
+                return &clients[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    void addClient(uint32_t id)
+    {
+        TelemetryClientType *client = find(0);
+
+        if (client != NULL)
+        {
+            *client = {id, rateToPeriod(DEFAULT_RATE), 0, 0, 0};
+        }
+    }
+
+    void removeClient(uint32_t id)
+    {
+        TelemetryClientType *client = find(id);
+
+        if (client != NULL && id != 0)
+        {
+            client->id = 0;
+        }
+    }
+
+    void setRate(uint32_t id, float hz)
+    {
+        TelemetryClientType *client = find(id);
+
+        if (client != NULL && id != 0)
+        {
+            client->period = rateToPeriod(hz);
+        }
+    }
+
+    bool due()
+    {
+        uint32_t now = millis();
+
+        for (uint8_t i = 0; i < TELEMETRY_MAX_CLIENTS; i++)
+        {
+            if (clients[i].id != 0 && isDue(clients[i].period, clients[i].lastSent, now))
+            {
+                return true;
+            }
+        }
+
+        return UdpLink::active() && isDue(rateToPeriod(UDP_RATE), udpLastSent, now);
+    }
+
+    // Runs on the async_tcp task, the only one that adds, removes or writes
+    // to WebSocket clients, so the client list and queues are never shared
+    static void flush(void *arg)
+    {
+        AsyncWebSocket &ws = *(AsyncWebSocket *)arg;
+        uint8_t data[TELEMETRY_MAX_FRAME];
+        size_t len;
+
+        flushQueued = false;
+        __sync_synchronize(); // a frame published from here on queues another flush
+
+        portENTER_CRITICAL(&snapshotMux);
+        len = snapshotLength;
+        memcpy(data, snapshot, len);
+        portEXIT_CRITICAL(&snapshotMux);
+
+        uint32_t now = millis();
+
+        for (uint8_t i = 0; i < TELEMETRY_MAX_CLIENTS; i++)
+        {
+            TelemetryClientType &slot = clients[i];
+
+            if (slot.id == 0 || !isDue(slot.period, slot.lastSent, now))
+            {
+                continue;
+            }
+
+            AsyncWebSocketClient *client = ws.client(slot.id);
+            if (client == NULL || client->status() != WS_CONNECTED)
+            {
+                continue;
+            }
+
+            slot.lastSent = now;
+
+            // Latest wins: a frame still waiting in the queue is already
+            // stale, so a slow client skips this one instead of queueing more
+            if (!client->canSend() || client->queuedMessages() > 0)
+            {
+                slot.dropped++;
+                continue;
+            }
+
+            // Copied into one of the client's preallocated message slots,
+            // so steady-state telemetry never touches the heap
+            client->binary(data, len);
+            slot.sent++;
+        }
+    }
+
+    void send(AsyncWebSocket &ws, const uint8_t *data, size_t len)
+    {
+        if (len > TELEMETRY_MAX_FRAME)
+        {
+            return;
+        }
+
+        portENTER_CRITICAL(&snapshotMux);
+        memcpy(snapshot, data, len);
+        snapshotLength = len;
+        portEXIT_CRITICAL(&snapshotMux);
+
+        // One flush in flight at a time; it always sends the newest snapshot
+        if (!__sync_lock_test_and_set(&flushQueued, true))
+        {
+            if (!async_tcp_call(flush, &ws))
+            {
+                flushQueued = false;
+            }
+        }
+
+        uint32_t now = millis();
+
+        // AsyncUDP hands the packet to the lwIP thread itself
+        if (isDue(rateToPeriod(UDP_RATE), udpLastSent, now))
+        {
+            udpLastSent = now;
+            UdpLink::send(data, len);
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#include <esp_timer.h>
+#include "timing.h"
+
+namespace Timing
+{
+    TimestampType now()
+    {
+        return esp_timer_get_time();
+    }
+
+    float toSeconds(TimestampType duration)
+    {
+        return (float)duration * 1e-6f;
+    }
+}
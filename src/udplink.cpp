@@ -0,0 +1,93 @@
+#include <AsyncUDP.h>
+#include "udplink.h"
+#include "log.h"
+
+namespace UdpLink
+{
+    static const uint32_t TIMEOUT = 500; // ms without a valid frame before the link counts as lost
+
+    AsyncUDP udp;
+    ControlHandlerType controlHandler = NULL;
+
+    // Written in the UDP receive callback only
+    LinkFilterType filter = {};
+    volatile bool connected = false;
+    volatile uint32_t lastReceived = 0; // millis()
+
+    IPAddress peerAddress;
+    uint16_t peerPort = 0;
+
+    void onPacket(AsyncUDPPacket &packet)
+    {
+        ControlFrameType frame;
+        uint32_t now = millis();
+
+        if (!Protocol::decodeControl(packet.data(), packet.length(), frame))
+        {
+            filter.stats.invalid++;
+            return;
+        }
+
+        if (!connected)
+        {
+            LinkFilter::start(filter, frame, now);
+        }
+
+        if (!LinkFilter::accept(filter, frame, now))
+        {
+            return;
+        }
+
+        peerAddress = packet.remoteIP();
+        peerPort = packet.remotePort();
+        lastReceived = now;
+        connected = true;
+
+        controlHandler(frame);
+    }
+
+    void init(uint16_t port, ControlHandlerType handler)
+    {
+        controlHandler = handler;
+
+        if (!udp.listen(port))
+        {
+            Log::error("UDP listen failed on port " + String(port));
+            return;
+        }
+
+        udp.onPacket(onPacket);
+    }
+
+    bool active()
+    {
+        return connected;
+    }
+
+    // True once when a peer stops sending, so the caller can fail safe
+    bool lost()
+    {
+        if (connected && millis() - lastReceived > TIMEOUT)
+        {
+            connected = false;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool send(const uint8_t *data, size_t len)
+    {
+        if (!connected)
+        {
+            return false;
+        }
+
+        return udp.writeTo(data, len, peerAddress, peerPort) == len;
+    }
+
+    LinkStatsType getStats()
+    {
+        return filter.stats;
+    }
+}
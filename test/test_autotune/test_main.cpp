@@ -0,0 +1,144 @@
+#include <unity.h>
+#include <complex>
+#include <math.h>
+#include "autotune.h"
+
+// Autotune against sampled rate plants at the 1 kHz control rate, with the
+// relay settings Rc uses. A command reaches the motors `delay` samples later,
+// thrust follows it through a first order lag and the rate settles at `gain`
+// deg/s per motor unit; the tuner sees the rate one sample later, as it does
+// in the control loop. So the loop is
+//   L(z) = gain * a * z^-(delay + 1) / (1 - (1 - a) z^-1),  a = dt / (lag + dt)
+// and its ultimate point is exact, found where the phase of L crosses -180.
+//
+// Tolerances: Ku within 12%. Pu within 20%, because the relay can only
+// switch on a sample and its hysteresis slows the limit cycle below the
+// ultimate frequency, most on plants whose oscillation is only a few
+// hysteresis widths tall.
+
+static const double DT = 0.001; // s
+static const float AUTOTUNE_RELAY = 20.0f;     // Rc
+static const float AUTOTUNE_HYSTERESIS = 2.0f; // Rc
+static const uint8_t AUTOTUNE_CYCLES = 5;      // Rc
+
+typedef struct
+{
+    double gain; // deg/s per motor unit
+    double lag;  // s
+    int delay;   // samples
+} PlantType;
+
+static void analyticUltimate(const PlantType &plant, double &gain, double &period)
+{
+    double a = DT / (plant.lag + DT);
+    double low = 1e-3;
+    double high = M_PI / DT;
+
+    for (int i = 0; i < 100; i++)
+    {
+        double w = 0.5 * (low + high);
+        std::complex<double> pole = 1.0 - (1.0 - a) * std::polar(1.0, -w * DT);
+
+        if (-(plant.delay + 1) * w * DT - std::arg(pole) > -M_PI)
+        {
+            low = w;
+        }
+        else
+        {
+            high = w;
+        }
+    }
+
+    gain = std::abs(1.0 - (1.0 - a) * std::polar(1.0, -low * DT)) / (plant.gain * a);
+    period = 2.0 * M_PI / low;
+}
+
+static void checkPlant(const PlantType &plant)
+{
+    AutotuneType tuner;
+    float pipeline[32] = {0};
+    float motor = 0.0f;
+    float rate = 0.0f;
+    float a = (float)(DT / (plant.lag + DT));
+
+    Autotune::start(tuner, 0.0f, AUTOTUNE_RELAY, AUTOTUNE_HYSTERESIS, AUTOTUNE_CYCLES, 10.0f);
+
+    for (int i = 0; tuner.state == AUTOTUNE_RUNNING; i++)
+    {
+        float command = pipeline[i % plant.delay];
+        pipeline[i % plant.delay] = Autotune::update(tuner, rate, (float)DT);
+
+        motor += a * (command - motor);
+        rate = (float)plant.gain * motor;
+    }
+
+    double gain, period;
+    analyticUltimate(plant, gain, period);
+
+    TEST_ASSERT_EQUAL(AUTOTUNE_DONE, tuner.state);
+    TEST_ASSERT_FLOAT_WITHIN(0.12 * gain, gain, tuner.ultimateGain);
+    TEST_ASSERT_FLOAT_WITHIN(0.20 * period, period, tuner.ultimatePeriod);
+
+    // Ziegler-Nichols "some overshoot" from the measured point
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, tuner.ultimateGain / 3.0f, tuner.kp);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f * tuner.ki, tuner.kp / (0.5f * tuner.ultimatePeriod), tuner.ki);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, tuner.kp * tuner.ultimatePeriod / 3.0f, tuner.kd);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_quad_rate_plant()
+{
+    checkPlant({5.0, 0.03, 5});
+}
+
+void test_fast_motors_short_delay()
+{
+    checkPlant({8.0, 0.05, 3});
+}
+
+void test_slow_plant_long_delay()
+{
+    checkPlant({10.0, 0.1, 10});
+}
+
+void test_low_gain_plant()
+{
+    checkPlant({2.0, 0.02, 8});
+}
+
+void test_times_out_without_a_limit_cycle()
+{
+    AutotuneType tuner;
+
+    // An input that never crosses the setpoint never completes a cycle
+    Autotune::start(tuner, 0.0f, AUTOTUNE_RELAY, AUTOTUNE_HYSTERESIS, AUTOTUNE_CYCLES, 1.0f);
+
+    for (int i = 0; i < 2000 && tuner.state == AUTOTUNE_RUNNING; i++)
+    {
+        Autotune::update(tuner, 50.0f, (float)DT);
+    }
+
+    TEST_ASSERT_EQUAL(AUTOTUNE_FAILED, tuner.state);
+    TEST_ASSERT_EQUAL(0.0f, tuner.output);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_quad_rate_plant);
+    RUN_TEST(test_fast_motors_short_delay);
+    RUN_TEST(test_slow_plant_long_delay);
+    RUN_TEST(test_low_gain_plant);
+    RUN_TEST(test_times_out_without_a_limit_cycle);
+    return UNITY_END();
+}
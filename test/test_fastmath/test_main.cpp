@@ -0,0 +1,87 @@
+#include <unity.h>
+#include <math.h>
+#include "fastmath.h"
+
+// Worst error of each FastMath kernel against double libm over dense sweeps,
+// checked against the bound its comment in fastmath.h states.
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_inv_sqrt_and_sqrt_relative_error()
+{
+    double worstInvSqrt = 0.0;
+    double worstSqrt = 0.0;
+
+    // Every mantissa step of 1e-5 over 40 binades covers the whole
+    // magic-constant error curve many times over
+    for (int exponent = -20; exponent < 20; exponent++)
+    {
+        for (int i = 0; i < 100000; i++)
+        {
+            float x = ldexpf(1.0f + i * 1e-5f, exponent);
+            double invSqrt = 1.0 / sqrt((double)x);
+            double root = sqrt((double)x);
+
+            worstInvSqrt = fmax(worstInvSqrt, fabs(FastMath::invSqrt(x) - invSqrt) / invSqrt);
+            worstSqrt = fmax(worstSqrt, fabs(FastMath::sqrt(x) - root) / root);
+        }
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(5e-6f, (float)worstInvSqrt);
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(5e-6f, (float)worstSqrt);
+    TEST_ASSERT_EQUAL(0.0f, FastMath::sqrt(0.0f));
+}
+
+void test_atan2_absolute_error()
+{
+    const float radii[] = {1e-3f, 1.0f, 1e3f};
+    double worst = 0.0;
+
+    for (int i = 0; i < 1000000; i++)
+    {
+        double theta = 2.0 * M_PI * i / 1000000.0;
+
+        for (float radius : radii)
+        {
+            float y = radius * (float)sin(theta);
+            float x = radius * (float)cos(theta);
+            worst = fmax(worst, fabs(FastMath::atan2(y, x) - atan2((double)y, (double)x)));
+        }
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(2e-6f, (float)worst);
+    TEST_ASSERT_EQUAL(0.0f, FastMath::atan2(0.0f, 0.0f));
+}
+
+void test_asin_absolute_error()
+{
+    double worst = 0.0;
+
+    for (int i = 0; i <= 2000000; i++)
+    {
+        float x = -1.0f + 2.0f * i / 2000000.0f;
+        worst = fmax(worst, fabs(FastMath::asin(x) - asin((double)x)));
+    }
+
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(7.5e-5f, (float)worst);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, FastMath::HALF_PI_F, FastMath::asin(1.5f));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, -FastMath::HALF_PI_F, FastMath::asin(-1.5f));
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_inv_sqrt_and_sqrt_relative_error);
+    RUN_TEST(test_atan2_absolute_error);
+    RUN_TEST(test_asin_absolute_error);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+#include <unity.h>
+#include <math.h>
+#include <stdint.h>
+#include "filter.h"
+#include "fusion.h"
+
+// Synthetic IMU traces through the same anti-alias low-pass and fusion step
+// Imu uses, at the 1 kHz sensor rate. Body y is to the right and the accel
+// reads +1 g on z when level, so a roll of r gives (0, -g sin r, g cos r).
+
+static const float RATE = 1000.0f;  // Hz
+static const float DT = 1.0f / RATE;
+static const float G = 9.80665f;
+static const float ACC_PART = 0.002f; // Imu ACC_PART
+static const float DEG = 0.0174532925f;
+
+typedef struct
+{
+    float roll;     // rad, true attitude
+    float rollRate; // rad/s
+    float lateral;  // m/s^2 along body y that is not gravity
+    float vertical; // m/s^2 along body z that is not gravity
+} TruthType;
+
+typedef TruthType (*TraceType)(float t);
+
+static uint32_t seed;
+
+static float noise(float amplitude)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return ((float)(seed >> 8) / 16777216.0f - 0.5f) * 2.0f * amplitude;
+}
+
+// Worst roll error in degrees from `settle` s on, over `seconds` of the trace
+static float worstRollError(TraceType trace, FusionModeType mode, float seconds, float settle, float noiseAmplitude, float gyroBias)
+{
+    FusionType fusion;
+    BiquadType accelY, accelZ, gyroX;
+
+    Fusion::init(fusion, mode, ACC_PART);
+    fusion.angles.x = trace(0.0f).roll;
+
+    Filter::initLowPass(accelY, RATE, 50.0f);
+    Filter::initLowPass(accelZ, RATE, 50.0f);
+    Filter::initLowPass(gyroX, RATE, 100.0f);
+    Filter::reset(accelY, -G * sinf(fusion.angles.x));
+    Filter::reset(accelZ, G * cosf(fusion.angles.x));
+    Filter::reset(gyroX, 0.0f);
+
+    seed = 1;
+    float worst = 0.0f;
+
+    for (int i = 0; i < (int)(seconds * RATE); i++)
+    {
+        float t = i * DT;
+        TruthType truth = trace(t);
+
+        AxisType accel = {0.0f,
+                          Filter::apply(accelY, -G * sinf(truth.roll) + truth.lateral + noise(noiseAmplitude)),
+                          Filter::apply(accelZ, G * cosf(truth.roll) + truth.vertical + noise(noiseAmplitude))};
+        AxisType gyro = {Filter::apply(gyroX, truth.rollRate + gyroBias + noise(noiseAmplitude * 0.1f)), 0.0f, 0.0f};
+
+        Fusion::update(fusion, accel, gyro, DT);
+
+        if (t >= settle)
+        {
+            worst = fmaxf(worst, fabsf(fusion.angles.x - truth.roll) / DEG);
+        }
+    }
+
+    return worst;
+}
+
+static TruthType hover(float t)
+{
+    (void)t;
+    return {0.0f, 0.0f, 0.0f, 0.0f};
+}
+
+// Level flight pulled sideways at 0.8 g, ramped in over 100 ms: a hard
+// translation without banking
+static TruthType lateralPull(float t)
+{
+    return {0.0f, 0.0f, 0.8f * G * fminf(1.0f, t / 0.1f), 0.0f};
+}
+
+// 30 deg bank entered at 100 deg/s, then held
+static TruthType bank(float t)
+{
+    float entry = 30.0f / 100.0f;
+
+    if (t < entry)
+    {
+        return {100.0f * DEG * t, 100.0f * DEG, 0.0f, 0.0f};
+    }
+
+    return {30.0f * DEG, 0.0f, 0.0f, 0.0f};
+}
+
+// 10 deg hold with 2 g of 200 Hz motor vibration on z
+static TruthType vibration(float t)
+{
+    return {10.0f * DEG, 0.0f, 0.0f, 2.0f * G * sinf(2.0f * 3.14159265f * 200.0f * t)};
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_hover_with_noise_stays_level()
+{
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(0.5f, worstRollError(hover, FUSION_ADAPTIVE, 5.0f, 0.0f, 0.5f, 0.0f));
+}
+
+void test_lateral_acceleration_does_not_tilt_the_estimate()
+{
+    float fixed = worstRollError(lateralPull, FUSION_FIXED, 1.0f, 0.0f, 0.2f, 0.0f);
+    float adaptive = worstRollError(lateralPull, FUSION_ADAPTIVE, 1.0f, 0.0f, 0.2f, 0.0f);
+
+    // The trace is aggressive enough to matter, and the adaptive weight rejects it
+    TEST_ASSERT_GREATER_OR_EQUAL_FLOAT(20.0f, fixed);
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(2.0f, adaptive);
+}
+
+void test_bank_is_tracked_and_gyro_bias_corrected()
+{
+    // 0.5 deg/s of gyro bias; the accel must hold the steady-state error down
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(1.0f, worstRollError(bank, FUSION_ADAPTIVE, 5.0f, 0.0f, 0.2f, 0.5f * DEG));
+}
+
+void test_motor_vibration_does_not_tilt_the_estimate()
+{
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(1.0f, worstRollError(vibration, FUSION_ADAPTIVE, 5.0f, 0.0f, 0.2f, 0.0f));
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_hover_with_noise_stays_level);
+    RUN_TEST(test_lateral_acceleration_does_not_tilt_the_estimate);
+    RUN_TEST(test_bank_is_tracked_and_gyro_bias_corrected);
+    RUN_TEST(test_motor_vibration_does_not_tilt_the_estimate);
+    return UNITY_END();
+}
@@ -0,0 +1,218 @@
+#include <unity.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "protocol.h"
+#include "linkfilter.h"
+
+// Loopback client for the UDP control path: frames are packed, sent over a
+// real socket on 127.0.0.1 and screened by LinkFilter the way UdpLink does.
+// Local time is simulated, the client clock runs CLIENT_OFFSET ahead of it.
+
+static const uint32_t CLIENT_OFFSET = 12345678; // ms
+static const uint32_t PERIOD = 20;              // ms between frames
+static const uint32_t DELAY = 5;                // ms, normal network delay
+
+static int receiver = -1;
+static int sender = -1;
+static sockaddr_in address;
+static LinkFilterType filter;
+static bool started;
+static uint32_t applied; // sequence of the last frame let through
+
+void setUp()
+{
+    receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    sender = socket(AF_INET, SOCK_DGRAM, 0);
+    TEST_ASSERT_TRUE(receiver >= 0 && sender >= 0);
+
+    address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    TEST_ASSERT_EQUAL(0, bind(receiver, (sockaddr *)&address, sizeof(address)));
+
+    socklen_t length = sizeof(address);
+    TEST_ASSERT_EQUAL(0, getsockname(receiver, (sockaddr *)&address, &length));
+
+    timeval timeout = {1, 0};
+    setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    filter = {};
+    started = false;
+    applied = 0;
+}
+
+void tearDown()
+{
+    close(receiver);
+    close(sender);
+}
+
+static void sendFrame(uint32_t sequence, uint32_t clientTimestamp)
+{
+    ControlFrameType frame = {};
+    frame.sequence = sequence;
+    frame.clientTimestamp = clientTimestamp;
+    frame.throttle = 90.0f;
+
+    uint8_t data[PROTOCOL_CONTROL_SIZE];
+    size_t len = Protocol::encodeControl(frame, data);
+
+    TEST_ASSERT_EQUAL(20, len);
+    TEST_ASSERT_EQUAL((int)len, (int)sendto(sender, data, len, 0, (sockaddr *)&address, sizeof(address)));
+}
+
+// Takes the next datagram off the socket and screens it at local time now
+static bool receiveFrame(uint32_t now)
+{
+    uint8_t data[64];
+    ssize_t len = recv(receiver, data, sizeof(data), 0);
+    ControlFrameType frame;
+
+    TEST_ASSERT_EQUAL(PROTOCOL_CONTROL_SIZE, (int)len);
+    TEST_ASSERT_TRUE(Protocol::decodeControl(data, len, frame));
+
+    if (!started)
+    {
+        LinkFilter::start(filter, frame, now);
+        started = true;
+    }
+
+    if (!LinkFilter::accept(filter, frame, now))
+    {
+        return false;
+    }
+
+    applied = frame.sequence;
+    return true;
+}
+
+// Frame `sequence` sent at local time sent, delivered at local time now
+static bool exchange(uint32_t sequence, uint32_t sent, uint32_t now)
+{
+    sendFrame(sequence, sent + CLIENT_OFFSET);
+    return receiveFrame(now);
+}
+
+static void steadyStream(uint32_t first, uint32_t count)
+{
+    for (uint32_t sequence = first; sequence < first + count; sequence++)
+    {
+        TEST_ASSERT_TRUE(exchange(sequence, sequence * PERIOD, sequence * PERIOD + DELAY));
+    }
+}
+
+void test_newest_frame_wins()
+{
+    steadyStream(1, 10);
+
+    // A burst of newer frames delivered together: each is newer, the last one stays applied
+    for (uint32_t sequence = 11; sequence <= 13; sequence++)
+    {
+        sendFrame(sequence, sequence * PERIOD + CLIENT_OFFSET);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_TRUE(receiveFrame(13 * PERIOD + DELAY));
+    }
+
+    TEST_ASSERT_EQUAL(13, applied);
+    TEST_ASSERT_EQUAL(13, filter.stats.received);
+    TEST_ASSERT_EQUAL(0, filter.stats.lost);
+}
+
+void test_out_of_order_frames_are_dropped()
+{
+    steadyStream(1, 2);
+
+    TEST_ASSERT_TRUE(exchange(4, 4 * PERIOD, 4 * PERIOD + DELAY));
+    TEST_ASSERT_FALSE(exchange(3, 3 * PERIOD, 4 * PERIOD + DELAY + 1));
+    TEST_ASSERT_FALSE(exchange(4, 4 * PERIOD, 4 * PERIOD + DELAY + 2));
+
+    TEST_ASSERT_EQUAL(4, applied);
+    TEST_ASSERT_EQUAL(2, filter.stats.outOfOrder);
+    TEST_ASSERT_EQUAL(1, filter.stats.lost);
+}
+
+void test_stale_frames_are_dropped()
+{
+    steadyStream(1, 10);
+
+    // A 300 ms WiFi stall releases 15 queued frames at once; only the ones
+    // still within the age limit may be applied, however many came before
+    uint32_t released = 10 * PERIOD + 300;
+    uint32_t accepted = 0;
+
+    for (uint32_t sequence = 11; sequence <= 25; sequence++)
+    {
+        sendFrame(sequence, sequence * PERIOD + CLIENT_OFFSET);
+    }
+
+    for (uint32_t sequence = 11; sequence <= 25; sequence++)
+    {
+        uint32_t age = released - sequence * PERIOD;
+
+        if (receiveFrame(released))
+        {
+            TEST_ASSERT_TRUE(age <= 100 + DELAY);
+            accepted++;
+        }
+        else
+        {
+            TEST_ASSERT_TRUE(age > 100 + DELAY);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(25, applied);
+    TEST_ASSERT_EQUAL(6, accepted);
+    TEST_ASSERT_EQUAL(9, filter.stats.stale);
+}
+
+void test_client_clock_step_back_rebases()
+{
+    steadyStream(1, 10);
+
+    // Client clock set back a minute: from then on every frame looks late
+    const uint32_t STEP = 60000;
+
+    for (uint32_t sequence = 11; sequence <= 20; sequence++)
+    {
+        sendFrame(sequence, sequence * PERIOD + CLIENT_OFFSET - STEP);
+        TEST_ASSERT_TRUE(receiveFrame(sequence * PERIOD + DELAY));
+    }
+
+    TEST_ASSERT_EQUAL(20, applied);
+    TEST_ASSERT_EQUAL(0, filter.stats.stale);
+}
+
+void test_client_clock_drift_is_followed()
+{
+    // Client clock 1% slow for 20 s, 200 ms of drift in total
+    for (uint32_t sequence = 1; sequence <= 1000; sequence++)
+    {
+        uint32_t now = sequence * PERIOD;
+
+        sendFrame(sequence, now - now / 100 + CLIENT_OFFSET);
+        TEST_ASSERT_TRUE(receiveFrame(now + DELAY));
+    }
+
+    TEST_ASSERT_EQUAL(0, filter.stats.stale);
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_newest_frame_wins);
+    RUN_TEST(test_out_of_order_frames_are_dropped);
+    RUN_TEST(test_stale_frames_are_dropped);
+    RUN_TEST(test_client_clock_step_back_rebases);
+    RUN_TEST(test_client_clock_drift_is_followed);
+    return UNITY_END();
+}